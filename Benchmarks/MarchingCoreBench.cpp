@@ -0,0 +1,325 @@
+// Micro-benchmarks of the engine independent marching core, built by the root CMakeLists.txt.
+//
+// MarchingCoreBench [--filter=<substring>] [--min-time=<seconds>] [--size=<points per axis>] [--seed=<seed>] [--csv]
+//
+// Every benchmark runs until it took at least min-time and reports the mean and fastest iteration, plus a throughput
+// for the unit of work it processes. Run it under perf/VTune with a filter to profile a single hot loop.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Core/CompactDensity.h"
+#include "Core/DensityGrid.h"
+#include "Core/DensityMip.h"
+#include "Core/MeshDecimation.h"
+#include "Core/MeshNormals.h"
+#include "Core/Mesher.h"
+#include "Core/TerrainDensity.h"
+#include "Utility/FastNoiseGrid.h"
+
+using namespace MarchingCore;
+
+namespace
+{
+	struct BenchmarkOptions
+	{
+		std::string Filter;
+		double MinTime = 0.5;
+		int PointsPerAxis = 32;
+		int Seed = 1337;
+		bool bCsv = false;
+	};
+
+	struct Benchmark
+	{
+		std::string Name;
+		// Unit of work the throughput is reported in, and how many of them one iteration processes
+		const char* ItemName;
+		std::function<double()> CountItems;
+		std::function<void()> Run;
+	};
+
+	struct BenchmarkResult
+	{
+		int Iterations = 0;
+		double MeanSeconds = 0.0;
+		double MinSeconds = 0.0;
+	};
+
+	// Keeps the compiler from dropping work whose result is never read
+	volatile float Sink;
+
+	BenchmarkResult Measure(const Benchmark& Bench, double MinTime)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		// One untimed run warms the caches and sizes the buffers
+		Bench.Run();
+
+		BenchmarkResult Result;
+		Result.MinSeconds = 1e30;
+		double Total = 0.0;
+		while (Total < MinTime || Result.Iterations < 3)
+		{
+			const Clock::time_point Start = Clock::now();
+			Bench.Run();
+			const double Seconds = std::chrono::duration<double>(Clock::now() - Start).count();
+			Total += Seconds;
+			Result.MinSeconds = std::min(Result.MinSeconds, Seconds);
+			Result.Iterations++;
+		}
+		Result.MeanSeconds = Total / Result.Iterations;
+		return Result;
+	}
+
+	bool ParseOption(const char* Arg, const char* Name, std::string& OutValue)
+	{
+		const size_t Length = std::strlen(Name);
+		if (std::strncmp(Arg, Name, Length) != 0 || Arg[Length] != '=')
+		{
+			return false;
+		}
+		OutValue = Arg + Length + 1;
+		return true;
+	}
+}
+
+int main(int Argc, char** Argv)
+{
+	BenchmarkOptions Options;
+	for (int i = 1; i < Argc; i++)
+	{
+		std::string Value;
+		if (ParseOption(Argv[i], "--filter", Value))
+		{
+			Options.Filter = Value;
+		}
+		else if (ParseOption(Argv[i], "--min-time", Value))
+		{
+			Options.MinTime = std::atof(Value.c_str());
+		}
+		else if (ParseOption(Argv[i], "--size", Value))
+		{
+			Options.PointsPerAxis = std::max(std::atoi(Value.c_str()), 2);
+		}
+		else if (ParseOption(Argv[i], "--seed", Value))
+		{
+			Options.Seed = std::atoi(Value.c_str());
+		}
+		else if (std::strcmp(Argv[i], "--csv") == 0)
+		{
+			Options.bCsv = true;
+		}
+		else
+		{
+			std::fprintf(stderr, "Usage: %s [--filter=<substring>] [--min-time=<seconds>] [--size=<points per axis>] [--seed=<seed>] [--csv]\n", Argv[0]);
+			return 1;
+		}
+	}
+
+	const int N = Options.PointsPerAxis;
+	const int NumPoints = N * N * N;
+
+	TerrainSettings Settings;
+	Settings.Seed = Options.Seed;
+	const TerrainDensity Terrain(Settings, N);
+
+	// The density of chunk (0, 0) crosses the ground level, so every meshing stage has work to do
+	DensityGrid Density(N);
+	Terrain.FillChunk(Density.GetData(), 0, 0, 0);
+
+	FastNoiseLite Noise;
+	Noise.SetSeed(Settings.Seed);
+	Noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+	Noise.SetFractalType(FastNoiseLite::FractalType_Ridged);
+	Noise.SetFrequency(Settings.Frequency);
+	Noise.SetFractalOctaves(Settings.Octaves);
+	std::vector<float> NoiseOut(NumPoints);
+
+	Mesher SharedMesher(N);
+	SharedMesher.BuildBrickSummary(Density.GetData());
+	SharedMesher.MarchAll(Density.GetData());
+
+	Mesher SoupMesher(N);
+	SoupMesher.bShareVertices = false;
+	SoupMesher.BuildBrickSummary(Density.GetData());
+
+	std::vector<Vec3> Verts(SharedMesher.GetNumMergedVerts());
+	std::vector<int32_t> Tris(SharedMesher.GetNumMergedIndices());
+	Verts.resize(SharedMesher.Merge(Verts.data(), Tris.data()));
+	std::vector<Vec3> Normals(Verts.size());
+	std::vector<Vec3> DecimatedVerts(Verts.size());
+	std::vector<int32_t> DecimatedTris(Tris.size());
+
+	Mesher GradientMesher(N);
+	GradientMesher.bGradientNormals = true;
+	GradientMesher.BuildBrickSummary(Density.GetData());
+
+	Mesher NetsMesher(N);
+	NetsMesher.Method = MeshingMethod::SurfaceNets;
+	NetsMesher.BuildBrickSummary(Density.GetData());
+	Mesher ContouringMesher(N);
+	ContouringMesher.Method = MeshingMethod::DualContouring;
+	ContouringMesher.BuildBrickSummary(Density.GetData());
+
+	// A distant chunk: every 4th point resampled and marched
+	constexpr int MipStride = 4;
+	const int MipPoints = DensityMip::GetPointsPerAxis(N, MipStride);
+	std::vector<float> Mip(static_cast<size_t>(MipPoints) * MipPoints * MipPoints);
+	Mesher MipMesher(MipPoints);
+
+	Mesher EditMesher(N);
+	EditMesher.BuildBrickSummary(Density.GetData());
+	EditMesher.MarchAll(Density.GetData());
+	std::vector<Vec3> EditVerts(EditMesher.GetNumMergedVerts());
+	std::vector<int32_t> EditTris(EditMesher.GetNumMergedIndices());
+	MarchScratch Scratch;
+
+	const auto Points = [NumPoints] { return static_cast<double>(NumPoints); };
+	const auto Triangles = [&Tris] { return static_cast<double>(Tris.size() / 3); };
+
+	std::vector<Benchmark> Benchmarks;
+	const FastNoiseGrid::SimdLevel Levels[] = { FastNoiseGrid::SimdLevel_Scalar, FastNoiseGrid::SimdLevel_SSE2, FastNoiseGrid::SimdLevel_AVX2 };
+	const char* LevelNames[] = { "Scalar", "SSE2", "AVX2" };
+	for (int i = 0; i < 3; i++)
+	{
+		if (Levels[i] > FastNoiseGrid::GetSupportedSimdLevel())
+		{
+			continue;
+		}
+		const FastNoiseGrid::SimdLevel Level = Levels[i];
+		Benchmarks.push_back({ std::string("Noise/Grid/") + LevelNames[i], "points", Points, [&, Level]
+		{
+			FastNoiseGrid::GenUniformGrid3D(Noise, NoiseOut.data(), -1.0f, -1.0f, 0.0f, N, N, N, 1.0f, Level);
+			Sink = NoiseOut[NumPoints / 2];
+		} });
+	}
+	Benchmarks.push_back({ "Terrain/FillChunk", "points", Points, [&]
+	{
+		Terrain.FillChunk(NoiseOut.data(), 0, 0, 0);
+		Sink = NoiseOut[NumPoints / 2];
+	} });
+	// A chunk generated after its -X, -Y and -Z neighbours, which hand over the planes they share with it
+	const uint8_t SharedBorders = TerrainDensity::GetBorderBit(0, false) | TerrainDensity::GetBorderBit(1, false) | TerrainDensity::GetBorderBit(2, false);
+	Benchmarks.push_back({ "Terrain/FillShared", "points", Points, [&]
+	{
+		Terrain.FillChunk(NoiseOut.data(), 0, 0, 0, SharedBorders);
+		Sink = NoiseOut[NumPoints / 2];
+	} });
+	CompactDensity Compact16;
+	CompactDensity Compact8;
+	Benchmarks.push_back({ "Density/Compress16", "points", Points, [&]
+	{
+		Compact16.Compress(Density.GetData(), N, SoupMesher.IsoLevel, DensityEncoding::Quantized16);
+	} });
+	Benchmarks.push_back({ "Density/Compress8", "points", Points, [&]
+	{
+		Compact8.Compress(Density.GetData(), N, SoupMesher.IsoLevel, DensityEncoding::Quantized8);
+	} });
+	Benchmarks.push_back({ "Density/Expand8", "points", Points, [&]
+	{
+		Compact8.Decompress(NoiseOut.data());
+		Sink = NoiseOut[NumPoints / 2];
+	} });
+	Benchmarks.push_back({ "Mesher/BrickSummary", "points", Points, [&]
+	{
+		SoupMesher.BuildBrickSummary(Density.GetData());
+	} });
+	Benchmarks.push_back({ "Mesher/MarchAll/Shared", "triangles", Triangles, [&]
+	{
+		SharedMesher.MarchAll(Density.GetData());
+	} });
+	Benchmarks.push_back({ "Mesher/MarchAll/Soup", "triangles", Triangles, [&]
+	{
+		SoupMesher.MarchAll(Density.GetData());
+	} });
+	// Marching with normals from the density gradient, the alternative to marching and then averaging face normals
+	Benchmarks.push_back({ "Mesher/MarchAll/Gradient", "triangles", Triangles, [&]
+	{
+		GradientMesher.MarchAll(Density.GetData());
+	} });
+	NetsMesher.MarchAll(Density.GetData());
+	const double NetsTriangles = NetsMesher.GetNumMergedIndices() / 3;
+	Benchmarks.push_back({ "Mesher/SurfaceNets", "triangles", [NetsTriangles] { return NetsTriangles; }, [&]
+	{
+		NetsMesher.MarchAll(Density.GetData());
+	} });
+	Benchmarks.push_back({ "Mesher/DualContouring", "triangles", [NetsTriangles] { return NetsTriangles; }, [&]
+	{
+		ContouringMesher.MarchAll(Density.GetData());
+	} });
+	Benchmarks.push_back({ "Mesher/MarchMip/Stride4", "points", Points, [&]
+	{
+		DensityMip::Downsample(Density.GetData(), N, MipStride, Mip.data());
+		MipMesher.BuildBrickSummary(Mip.data());
+		MipMesher.MarchAll(Mip.data());
+	} });
+	Benchmarks.push_back({ "Mesher/Merge", "triangles", Triangles, [&]
+	{
+		Sink = static_cast<float>(SharedMesher.Merge(Verts.data(), Tris.data()));
+	} });
+	Benchmarks.push_back({ "Normals/Average", "triangles", Triangles, [&]
+	{
+		CalcAverageNormals(Verts.data(), static_cast<int32_t>(Verts.size()), Tris.data(), static_cast<int32_t>(Tris.size()), Normals.data());
+		Sink = Normals[0].X;
+	} });
+	// Collision mesh of a chunk with vertices clustered into cells of 2 grid points
+	Benchmarks.push_back({ "Collision/Decimate", "triangles", Triangles, [&]
+	{
+		int32_t NumIndices = 0;
+		Sink = static_cast<float>(DecimateByClustering(Verts.data(), static_cast<int32_t>(Verts.size()), Tris.data(),
+			static_cast<int32_t>(Tris.size()), 2.0f, DecimatedVerts.data(), DecimatedTris.data(), NumIndices));
+	} });
+	// What a terraform brush of radius 3 pays: re-march the touched bricks and merge the chunk again
+	Benchmarks.push_back({ "Mesher/RemeshBrush", "triangles", Triangles, [&]
+	{
+		const int Center = N / 2;
+		const int Low = N / 5;
+		EditMesher.MarkPointsDirty(Center - 3, Center - 3, Low - 3, Center + 3, Center + 3, Low + 3);
+		for (int BrickIndex : EditMesher.TakeDirtyBricks(Density.GetData()))
+		{
+			EditMesher.MarchBrick(Density.GetData(), BrickIndex, Scratch);
+		}
+		Sink = static_cast<float>(EditMesher.Merge(EditVerts.data(), EditTris.data()));
+	} });
+
+	if (Options.bCsv)
+	{
+		std::printf("Name,Iterations,MeanUs,MinUs,Items,ItemsPerSecond\n");
+	}
+	else
+	{
+		std::printf("%d^3 points, %zu vertices, %zu triangles, noise kernels up to %s\n\n", N, Verts.size(), Tris.size() / 3,
+			LevelNames[FastNoiseGrid::GetSupportedSimdLevel()]);
+		std::printf("%-26s %10s %12s %12s %16s\n", "Benchmark", "Iterations", "Mean us", "Min us", "Throughput");
+	}
+
+	for (const Benchmark& Bench : Benchmarks)
+	{
+		if (!Options.Filter.empty() && Bench.Name.find(Options.Filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		const BenchmarkResult Result = Measure(Bench, Options.MinTime);
+		const double Items = Bench.CountItems();
+		const double ItemsPerSecond = Items / Result.MeanSeconds;
+		if (Options.bCsv)
+		{
+			std::printf("%s,%d,%.3f,%.3f,%.0f,%.0f\n", Bench.Name.c_str(), Result.Iterations,
+				Result.MeanSeconds * 1e6, Result.MinSeconds * 1e6, Items, ItemsPerSecond);
+		}
+		else
+		{
+			std::printf("%-26s %10d %12.2f %12.2f %10.2f M%s/s\n", Bench.Name.c_str(), Result.Iterations,
+				Result.MeanSeconds * 1e6, Result.MinSeconds * 1e6, ItemsPerSecond * 1e-6, Bench.ItemName);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ChunkCollisionSubsystem.h"
+
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+#include "MarchingChunk.h"
+
+TStatId UChunkCollisionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UChunkCollisionSubsystem, STATGROUP_Tickables);
+}
+
+void UChunkCollisionSubsystem::RegisterChunk(AMarchingChunk* Chunk)
+{
+	if (Chunk)
+	{
+		Chunks.AddUnique(Chunk);
+		Chunk->SetCollisionManaged(true);
+	}
+}
+
+void UChunkCollisionSubsystem::UnregisterChunk(AMarchingChunk* Chunk)
+{
+	if (Chunk)
+	{
+		Chunks.RemoveSwap(Chunk);
+		Chunk->SetCollisionManaged(false);
+	}
+}
+
+void UChunkCollisionSubsystem::AddAnchor(AActor* Anchor)
+{
+	if (Anchor)
+	{
+		Anchors.AddUnique(Anchor);
+	}
+}
+
+void UChunkCollisionSubsystem::RemoveAnchor(AActor* Anchor)
+{
+	Anchors.RemoveSwap(Anchor);
+}
+
+void UChunkCollisionSubsystem::GatherAnchorLocations(TArray<FVector>& OutLocations) const
+{
+	for (TActorIterator<APawn> It(GetWorld()); It; ++It)
+	{
+		OutLocations.Add(It->GetActorLocation());
+	}
+	for (const TWeakObjectPtr<AActor>& Anchor : Anchors)
+	{
+		if (const AActor* Actor = Anchor.Get())
+		{
+			OutLocations.Add(Actor->GetActorLocation());
+		}
+	}
+}
+
+void UChunkCollisionSubsystem::Tick(float DeltaTime)
+{
+	if (Chunks.IsEmpty())
+	{
+		return;
+	}
+
+	TArray<FVector> AnchorLocations;
+	GatherAnchorLocations(AnchorLocations);
+
+	struct FCookCandidate
+	{
+		AMarchingChunk* Chunk;
+		float DistSq;
+	};
+	TArray<FCookCandidate> Candidates;
+
+	const float ReleaseRadius = Policy.Radius + Policy.ReleasePadding;
+	for (int32 i = Chunks.Num() - 1; i >= 0; i--)
+	{
+		AMarchingChunk* Chunk = Chunks[i].Get();
+		if (!Chunk)
+		{
+			Chunks.RemoveAtSwap(i);
+			continue;
+		}
+		// Generation owns the mesh buffers until it commits, and a pooled chunk has nothing to collide with
+		if (Chunk->IsGenerating() || Chunk->IsPooled())
+		{
+			continue;
+		}
+
+		const FBox Bounds = Chunk->GetWorldBounds();
+		float DistSq = TNumericLimits<float>::Max();
+		for (const FVector& Location : AnchorLocations)
+		{
+			DistSq = FMath::Min(DistSq, static_cast<float>(Bounds.ComputeSquaredDistanceToPoint(Location)));
+		}
+
+		if (DistSq <= FMath::Square(Policy.Radius))
+		{
+			if (!Chunk->HasCollision() || Chunk->IsCollisionStale())
+			{
+				Candidates.Add({ Chunk, DistSq });
+			}
+		}
+		else if (DistSq > FMath::Square(ReleaseRadius) && Chunk->HasCollision())
+		{
+			Chunk->ClearCollision();
+		}
+	}
+
+	// The closest chunks are the ones something is about to stand on
+	Candidates.Sort([](const FCookCandidate& A, const FCookCandidate& B)
+	{
+		return A.DistSq < B.DistSq;
+	});
+	const int32 NumToCook = FMath::Min(Candidates.Num(), Policy.MaxCooksPerTick);
+	for (int32 i = 0; i < NumToCook; i++)
+	{
+		Candidates[i].Chunk->CookCollision(Policy.DecimationCellSize);
+	}
+}
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "ChunkCollisionSubsystem.generated.h"
+
+class AMarchingChunk;
+
+// When and how the collision of registered chunks is cooked
+USTRUCT(BlueprintType)
+struct FChunkCollisionPolicy
+{
+	GENERATED_BODY()
+
+	// Only chunks this close to a pawn or collision anchor get collision
+	UPROPERTY(EditAnywhere, Category = "Collision", meta = (ClampMin = "0"))
+	float Radius = 8000.f;
+
+	// Extra distance before the collision of a chunk is dropped again, so moving along the radius doesn't recook
+	UPROPERTY(EditAnywhere, Category = "Collision", meta = (ClampMin = "0"))
+	float ReleasePadding = 2000.f;
+
+	// Collision is cooked from the render mesh with its vertices clustered into cells of this many grid points, 1 cooks it as is
+	UPROPERTY(EditAnywhere, Category = "Collision", meta = (ClampMin = "1"))
+	int DecimationCellSize = 1;
+
+	// Limits how many chunks start cooking per frame, edits and newly relevant chunks wait for the next frames
+	UPROPERTY(EditAnywhere, Category = "Collision", meta = (ClampMin = "1"))
+	int MaxCooksPerTick = 2;
+};
+
+// Cooks the collision of registered chunks lazily: only near physics relevant actors, on the physics cooking threads,
+// and some frames after an edit instead of with every rebuilt mesh. Chunks that were never registered cook their
+// collision with every mesh as before.
+UCLASS()
+class MARCHINGCUBES_API UChunkCollisionSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void SetPolicy(const FChunkCollisionPolicy& InPolicy) { Policy = InPolicy; }
+	const FChunkCollisionPolicy& GetPolicy() const { return Policy; }
+
+	void RegisterChunk(AMarchingChunk* Chunk);
+	// The chunk cooks its own collision again afterwards
+	void UnregisterChunk(AMarchingChunk* Chunk);
+
+	// Actors besides pawns that need collision around them, e.g. simulated physics props
+	void AddAnchor(AActor* Anchor);
+	void RemoveAnchor(AActor* Anchor);
+
+private:
+	void GatherAnchorLocations(TArray<FVector>& OutLocations) const;
+
+	FChunkCollisionPolicy Policy;
+
+	TArray<TWeakObjectPtr<AMarchingChunk>> Chunks;
+	TArray<TWeakObjectPtr<AActor>> Anchors;
+};
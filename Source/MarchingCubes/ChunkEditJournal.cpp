@@ -0,0 +1,220 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ChunkEditJournal.h"
+
+#include "Algo/BinarySearch.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogChunkEditJournal, Log, All);
+
+FChunkEditJournal::FChunkEditJournal(const FString& InPath, TSharedRef<FChunkRegionStore> InRegionStore,
+	TSharedRef<const FTerrainGenerator> InTerrainGenerator, const FGridMetrics& InGridMetrics, float InIsoLevel)
+	: Path(InPath)
+	, RegionStore(InRegionStore)
+	, TerrainGenerator(InTerrainGenerator)
+	, GridMetrics(InGridMetrics)
+	, IsoLevel(InIsoLevel)
+{
+	TArray<uint8> Existing;
+	if (FFileHelper::LoadFileToArray(Existing, *Path, FILEREAD_Silent))
+	{
+		MarchingCore::EditJournal::Header Header;
+		std::vector<MarchingCore::BrushEdit> Edits;
+		if (MarchingCore::EditJournal::Read(Existing.GetData(), Existing.Num(), Header, Edits))
+		{
+			PendingEdits.Append(Edits.data(), static_cast<int32>(Edits.size()));
+			NextSequence = FMath::Max(Header.NextSequence, PendingEdits.Num() > 0 ? PendingEdits.Last().Sequence + 1 : 1u);
+		}
+		else
+		{
+			UE_LOG(LogChunkEditJournal, Warning, TEXT("Ignoring edit journal %s, it was written for another format"), *Path);
+		}
+		if (PendingEdits.Num() > 0)
+		{
+			UE_LOG(LogChunkEditJournal, Log, TEXT("Recovered %d edits from %s"), PendingEdits.Num(), *Path);
+		}
+	}
+
+	// Start over from the intact records, so new ones aren't appended behind a torn one
+	FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*FPaths::GetPath(Path));
+	if (!RewriteFile(NextSequence, PendingEdits))
+	{
+		UE_LOG(LogChunkEditJournal, Warning, TEXT("Could not open edit journal %s, edits won't be saved"), *Path);
+	}
+}
+
+FChunkEditJournal::~FChunkEditJournal()
+{
+	Wait();
+	File.Reset();
+}
+
+void FChunkEditJournal::Append(MarchingCore::BrushEdit Edit)
+{
+	Edit.Sequence = NextSequence++;
+	PendingEdits.Add(Edit);
+	MarchingCore::EditJournal::AppendRecord(UnflushedRecords, Edit);
+}
+
+void FChunkEditJournal::Flush()
+{
+	PruneFoldedEdits();
+	if (UnflushedRecords.empty())
+	{
+		return;
+	}
+
+	LastTask = Pipe.Launch(UE_SOURCE_LOCATION, [this, Records = MoveTemp(UnflushedRecords)]()
+	{
+		WriteToFile(Records);
+	});
+	UnflushedRecords.clear();
+}
+
+void FChunkEditJournal::Compact()
+{
+	Flush();
+	if (PendingEdits.Num() == 0 || IsCompacting())
+	{
+		return;
+	}
+
+	// Every pending edit is in the file or about to be when the pipe gets to the compaction, later ones are appended after it
+	CompactionTask = Pipe.Launch(UE_SOURCE_LOCATION, [this, Edits = PendingEdits]()
+	{
+		FoldEdits(Edits);
+	});
+	LastTask = CompactionTask;
+}
+
+void FChunkEditJournal::Wait()
+{
+	LastTask.Wait();
+	PruneFoldedEdits();
+}
+
+void FChunkEditJournal::GetEditsAfter(const FIntVector& Coord, uint32 Sequence, TArray<MarchingCore::BrushEdit>& OutEdits) const
+{
+	OutEdits.Reset();
+	for (const MarchingCore::BrushEdit& Edit : PendingEdits)
+	{
+		int Min[3];
+		int Max[3];
+		if (Edit.Sequence > Sequence && MarchingCore::GetBrushBox(Edit, Coord.X, Coord.Y, Coord.Z, GridMetrics.GetPointsPerChunk(), Min, Max))
+		{
+			OutEdits.Add(Edit);
+		}
+	}
+}
+
+void FChunkEditJournal::PruneFoldedEdits()
+{
+	const uint32 Folded = FoldedSequence.load();
+	const int32 NumFolded = Algo::LowerBoundBy(PendingEdits, Folded + 1, &MarchingCore::BrushEdit::Sequence);
+	if (NumFolded > 0)
+	{
+		PendingEdits.RemoveAt(0, NumFolded);
+	}
+}
+
+void FChunkEditJournal::WriteToFile(const std::vector<uint8_t>& Bytes)
+{
+	if (File && File->Write(Bytes.data(), Bytes.size()))
+	{
+		File->Flush();
+	}
+}
+
+bool FChunkEditJournal::RewriteFile(uint32 FileNextSequence, const TArray<MarchingCore::BrushEdit>& Edits)
+{
+	File.Reset();
+	File.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Path));
+	if (!File)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> Bytes;
+	MarchingCore::EditJournal::Header Header;
+	Header.NextSequence = FileNextSequence;
+	MarchingCore::EditJournal::AppendHeader(Bytes, Header);
+	for (const MarchingCore::BrushEdit& Edit : Edits)
+	{
+		MarchingCore::EditJournal::AppendRecord(Bytes, Edit);
+	}
+	const bool bWritten = File->Write(Bytes.data(), Bytes.size());
+	File->Flush();
+	return bWritten;
+}
+
+void FChunkEditJournal::FoldEdits(const TArray<MarchingCore::BrushEdit>& Edits)
+{
+	const int N = GridMetrics.GetPointsPerChunk();
+
+	// The edits reaching each chunk, in the order they were made
+	TMap<FIntVector, TArray<int32>> EditsByChunk;
+	for (int32 i = 0; i < Edits.Num(); i++)
+	{
+		MarchingCore::ForEachBrushChunk(Edits[i], N, [&EditsByChunk, i](int X, int Y, int Z, const int*, const int*)
+		{
+			EditsByChunk.FindOrAdd(FIntVector(X, Y, Z)).Add(i);
+		});
+	}
+
+	const uint32 LastSequence = Edits.Last().Sequence;
+	TArray<float> Density;
+	Density.SetNumUninitialized(N * N * N);
+	TArray<uint8> Blob;
+	bool bAllFolded = true;
+	for (const TPair<FIntVector, TArray<int32>>& Pair : EditsByChunk)
+	{
+		const FIntVector& Coord = Pair.Key;
+
+		// Start from the last snapshot, or from the noise for a chunk that was never saved
+		uint32 SnapshotSequence = 0;
+		if (!RegionStore->ReadChunk(Coord, Blob, &SnapshotSequence) || !FChunkRegionStore::DecodeChunk(Blob, N, Density.GetData()))
+		{
+			SnapshotSequence = 0;
+			TerrainGenerator->FillChunkDensity(Density.GetData(), Coord, IsoLevel);
+		}
+
+		// A compaction cut short before it emptied the file leaves edits behind that are in the snapshot already
+		bool bChanged = false;
+		for (const int32 Index : Pair.Value)
+		{
+			const MarchingCore::BrushEdit& Edit = Edits[Index];
+			int Min[3];
+			int Max[3];
+			if (Edit.Sequence > SnapshotSequence && MarchingCore::GetBrushBox(Edit, Coord.X, Coord.Y, Coord.Z, N, Min, Max))
+			{
+				MarchingCore::ApplyBrushEdit(Edit, Coord.X, Coord.Y, Coord.Z, N, Density.GetData(), Min, Max);
+				bChanged = true;
+			}
+		}
+		if (!bChanged)
+		{
+			continue;
+		}
+
+		// Lossless, so compactions don't pile up rounding errors and the chunk still matches its neighbours' borders
+		MarchingCore::CompactDensity Snapshot;
+		Snapshot.Compress(Density.GetData(), N, IsoLevel, MarchingCore::DensityEncoding::Float);
+		bAllFolded &= RegionStore->WriteChunk(Coord, Snapshot, LastSequence);
+	}
+
+	// Keep the file when a snapshot could not be written, the next compaction tries again
+	if (!bAllFolded)
+	{
+		UE_LOG(LogChunkEditJournal, Warning, TEXT("Could not fold every edit of %s into its region files"), *Path);
+		return;
+	}
+	if (!RewriteFile(LastSequence + 1, {}))
+	{
+		UE_LOG(LogChunkEditJournal, Warning, TEXT("Could not empty edit journal %s"), *Path);
+	}
+	FoldedSequence = LastSequence;
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkRegionStore.h"
+#include "TerrainGenerator.h"
+#include "Core/EditJournal.h"
+#include "Tasks/Pipe.h"
+#include "Utility/GridMetrics.h"
+
+#include <atomic>
+#include <vector>
+
+class IFileHandle;
+
+// Append-only log of the brush edits of a world, next to its region files. Every stroke is logged as a few dozen bytes
+// and written on a background pipe, so saving costs I/O in proportion to the edits rather than to the chunks they touched.
+// Compact folds the logged edits into the chunk snapshots of FChunkRegionStore on the same pipe and empties the log.
+// Edits a snapshot doesn't hold yet are replayed when its chunk loads, which is also how a session that ended without
+// compacting, e.g. in a crash, comes back.
+// Used from the game thread, the file is only touched by the pipe's tasks.
+class MARCHINGCUBES_API FChunkEditJournal
+{
+public:
+	// Opens the journal at InPath and keeps the edits it still holds, dropping a record torn by a crash
+	FChunkEditJournal(const FString& InPath, TSharedRef<FChunkRegionStore> InRegionStore, TSharedRef<const FTerrainGenerator> InTerrainGenerator,
+		const FGridMetrics& InGridMetrics, float InIsoLevel);
+	// Waits for the pipe, edits that were never flushed are lost
+	~FChunkEditJournal();
+
+	// Logs an edit that was already applied to the loaded chunks, it reaches the file with the next Flush
+	void Append(MarchingCore::BrushEdit Edit);
+	// Writes the edits logged since the last flush on the pipe
+	void Flush();
+	// Flushes, then folds every logged edit into the snapshots of the chunks it reached on the pipe
+	void Compact();
+	bool IsCompacting() const { return CompactionTask.IsValid() && !CompactionTask.IsCompleted(); }
+	// Blocks until everything launched on the pipe is done
+	void Wait();
+
+	// Logged edits not folded into snapshots yet
+	int32 GetNumPendingEdits() const { return PendingEdits.Num(); }
+	// Logged edits reaching the chunk at Coord that came after Sequence, the one its snapshot was folded up to
+	void GetEditsAfter(const FIntVector& Coord, uint32 Sequence, TArray<MarchingCore::BrushEdit>& OutEdits) const;
+
+private:
+	// Drops the pending edits a finished compaction folded
+	void PruneFoldedEdits();
+	// Pipe tasks
+	void WriteToFile(const std::vector<uint8_t>& Bytes);
+	void FoldEdits(const TArray<MarchingCore::BrushEdit>& Edits);
+	// Replaces the file with a header and Edits
+	bool RewriteFile(uint32 FileNextSequence, const TArray<MarchingCore::BrushEdit>& Edits);
+
+	FString Path;
+	TSharedRef<FChunkRegionStore> RegionStore;
+	TSharedRef<const FTerrainGenerator> TerrainGenerator;
+	FGridMetrics GridMetrics;
+	float IsoLevel;
+
+	// Edits in the order they were made, from the last compaction on
+	TArray<MarchingCore::BrushEdit> PendingEdits;
+	// Records logged since the last flush
+	std::vector<uint8_t> UnflushedRecords;
+	uint32 NextSequence = 1;
+	// Written by the compaction task once every edit up to it is in a snapshot
+	std::atomic<uint32> FoldedSequence{0};
+
+	// Open for appending, only used by the pipe's tasks
+	TUniquePtr<IFileHandle> File;
+	UE::Tasks::FPipe Pipe{ UE_SOURCE_LOCATION };
+	UE::Tasks::FTask LastTask;
+	UE::Tasks::FTask CompactionTask;
+};
@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ChunkMeshCache.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	constexpr uint32 EntryMagic = 0x484D434D; // "MCMH"
+
+	// Followed by the vertices, indices and normals, each as raw array
+	struct FEntryHeader
+	{
+		uint32 Magic = EntryMagic;
+		uint32 Version = FChunkMeshCache::Version;
+		// Repeated from the path, a file that was copied or renamed into the wrong place is ignored
+		uint64 SettingsHash = 0;
+		FIntVector Coord = FIntVector::ZeroValue;
+		int32 NumVerts = 0;
+		int32 NumTris = 0;
+		int32 NumNormals = 0;
+	};
+
+	template<typename ElementType>
+	void AppendArray(TArray<uint8>& Out, const TArray<ElementType>& Array)
+	{
+		Out.Append(reinterpret_cast<const uint8*>(Array.GetData()), Array.Num() * sizeof(ElementType));
+	}
+
+	template<typename ElementType>
+	bool ReadArray(const TArray<uint8>& Data, int64& Offset, int32 Num, TArray<ElementType>& OutArray)
+	{
+		const int64 Size = static_cast<int64>(Num) * sizeof(ElementType);
+		if (Num < 0 || Offset + Size > Data.Num())
+		{
+			return false;
+		}
+		OutArray.SetNumUninitialized(Num);
+		FMemory::Memcpy(OutArray.GetData(), Data.GetData() + Offset, Size);
+		Offset += Size;
+		return true;
+	}
+}
+
+FChunkMeshCache::FChunkMeshCache(const FString& InDirectory)
+	: Directory(InDirectory)
+{
+}
+
+FString FChunkMeshCache::GetEntryPath(uint64 SettingsHash, const FIntVector& Coord) const
+{
+	return FPaths::Combine(Directory, FString::Printf(TEXT("%016llx"), SettingsHash), FString::Printf(TEXT("%d.%d.%d.mesh"), Coord.X, Coord.Y, Coord.Z));
+}
+
+bool FChunkMeshCache::Load(uint64 SettingsHash, const FIntVector& Coord, TArray<FVector3f>& OutVerts, TArray<int32>& OutTris,
+	TArray<MarchingCore::PackedNormal>& OutNormals) const
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *GetEntryPath(SettingsHash, Coord), FILEREAD_Silent) || Data.Num() < static_cast<int32>(sizeof(FEntryHeader)))
+	{
+		return false;
+	}
+
+	FEntryHeader Header;
+	FMemory::Memcpy(&Header, Data.GetData(), sizeof(Header));
+	if (Header.Magic != EntryMagic || Header.Version != Version || Header.SettingsHash != SettingsHash || Header.Coord != Coord
+		|| Header.NumTris % 3 != 0 || Header.NumNormals != Header.NumVerts)
+	{
+		return false;
+	}
+
+	int64 Offset = sizeof(Header);
+	if (!ReadArray(Data, Offset, Header.NumVerts, OutVerts)
+		|| !ReadArray(Data, Offset, Header.NumTris, OutTris)
+		|| !ReadArray(Data, Offset, Header.NumNormals, OutNormals))
+	{
+		return false;
+	}
+
+	// The mesh goes straight into the render section and collision cooking, a damaged index must not reach them
+	for (const int32 Index : OutTris)
+	{
+		if (static_cast<uint32>(Index) >= static_cast<uint32>(Header.NumVerts))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FChunkMeshCache::Store(uint64 SettingsHash, const FIntVector& Coord, const TArray<FVector3f>& Verts, const TArray<int32>& Tris,
+	const TArray<MarchingCore::PackedNormal>& Normals) const
+{
+	FEntryHeader Header;
+	Header.SettingsHash = SettingsHash;
+	Header.Coord = Coord;
+	Header.NumVerts = Verts.Num();
+	Header.NumTris = Tris.Num();
+	Header.NumNormals = Normals.Num();
+
+	TArray<uint8> Data;
+	Data.Reserve(sizeof(Header) + Verts.Num() * sizeof(FVector3f) + Tris.Num() * sizeof(int32)
+		+ Normals.Num() * sizeof(MarchingCore::PackedNormal));
+	Data.Append(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+	AppendArray(Data, Verts);
+	AppendArray(Data, Tris);
+	AppendArray(Data, Normals);
+
+	// A reader never sees a half written entry, and two chunks storing the same coordinate leave one whole entry
+	const FString Path = GetEntryPath(SettingsHash, Coord);
+	const FString TempPath = FPaths::CreateTempFilename(*FPaths::GetPath(Path), TEXT("mesh"), TEXT(".tmp"));
+	if (!FFileHelper::SaveArrayToFile(Data, *TempPath))
+	{
+		return false;
+	}
+	if (!IFileManager::Get().Move(*Path, *TempPath, true, true))
+	{
+		IFileManager::Get().Delete(*TempPath);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/MarchingTypes.h"
+
+// Keeps finished chunk meshes on disk, so a world that starts again with the same settings skips the noise and the
+// meshing of every chunk that wasn't edited. Entries are grouped in a folder per settings hash, which covers everything
+// a mesh is built from besides its coordinate (see AMarchingChunk::GetMeshSettingsHash). Changing any of it makes every
+// lookup miss and fills a new folder, the old one stays behind until it is deleted.
+// Every entry is a file of its own, written under a temporary name and moved into place, so it is used from any thread.
+class MARCHINGCUBES_API FChunkMeshCache
+{
+public:
+	// Bumped when the entry layout or the meshing changes in a way the settings hash doesn't see
+	static constexpr uint32 Version = 3;
+
+	explicit FChunkMeshCache(const FString& InDirectory);
+
+	// Reads the mesh of the chunk at Coord, false when there is no entry for these settings or it is damaged. A mesh that
+	// loads has a normal per vertex and only whole triangles of valid indices.
+	bool Load(uint64 SettingsHash, const FIntVector& Coord, TArray<FVector3f>& OutVerts, TArray<int32>& OutTris,
+		TArray<MarchingCore::PackedNormal>& OutNormals) const;
+	bool Store(uint64 SettingsHash, const FIntVector& Coord, const TArray<FVector3f>& Verts, const TArray<int32>& Tris,
+		const TArray<MarchingCore::PackedNormal>& Normals) const;
+
+private:
+	FString GetEntryPath(uint64 SettingsHash, const FIntVector& Coord) const;
+
+	FString Directory;
+};
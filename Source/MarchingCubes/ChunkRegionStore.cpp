@@ -0,0 +1,259 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ChunkRegionStore.h"
+
+#include "Async/MappedFileHandle.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Compression.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogChunkRegionStore, Log, All);
+
+namespace
+{
+	FIntVector ToRegionCoord(const FIntVector& ChunkCoord)
+	{
+		return FIntVector(MarchingCore::RegionFile::ToRegionCoord(ChunkCoord.X),
+			MarchingCore::RegionFile::ToRegionCoord(ChunkCoord.Y),
+			MarchingCore::RegionFile::ToRegionCoord(ChunkCoord.Z));
+	}
+
+	bool WriteAt(IFileHandle& File, int64 Offset, const void* Data, int64 Size)
+	{
+		return File.Seek(Offset) && File.Write(static_cast<const uint8*>(Data), Size);
+	}
+}
+
+FChunkRegionStore::FChunkRegionStore(const FString& InDirectory, const FGridMetrics& InGridMetrics)
+	: Directory(InDirectory)
+	, GridMetrics(InGridMetrics)
+{
+}
+
+FChunkRegionStore::~FChunkRegionStore()
+{
+	for (TPair<FIntVector, TUniquePtr<FRegion>>& Pair : Regions)
+	{
+		UnmapRegion(*Pair.Value);
+	}
+}
+
+FChunkRegionStore::FRegion& FChunkRegionStore::FindOrAddRegion(const FIntVector& Coord)
+{
+	const FIntVector RegionCoord = ToRegionCoord(Coord);
+	if (TUniquePtr<FRegion>* Found = Regions.Find(RegionCoord))
+	{
+		return **Found;
+	}
+
+	TUniquePtr<FRegion>& Region = Regions.Add(RegionCoord, MakeUnique<FRegion>());
+	Region->Path = FPaths::Combine(Directory, FString::Printf(TEXT("r.%d.%d.%d.mcr"), RegionCoord.X, RegionCoord.Y, RegionCoord.Z));
+	return *Region;
+}
+
+bool FChunkRegionStore::MapRegion(FRegion& Region)
+{
+	if (Region.MappedRegion)
+	{
+		return true;
+	}
+	if (Region.bMissing || Region.bIncompatible)
+	{
+		return false;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Region.Path))
+	{
+		Region.bMissing = true;
+		return false;
+	}
+
+	Region.MappedFile.Reset(PlatformFile.OpenMapped(*Region.Path));
+	if (Region.MappedFile && Region.MappedFile->GetFileSize() >= MarchingCore::RegionFile::DataOffset)
+	{
+		Region.MappedRegion.Reset(Region.MappedFile->MapRegion(0, Region.MappedFile->GetFileSize()));
+		Region.FileSize = FMath::Max(Region.FileSize, Region.MappedFile->GetFileSize());
+	}
+	if (!Region.MappedRegion)
+	{
+		UE_LOG(LogChunkRegionStore, Warning, TEXT("Could not map region file %s"), *Region.Path);
+		UnmapRegion(Region);
+		Region.bIncompatible = true;
+		return false;
+	}
+
+	if (!MarchingCore::RegionFile::IsCompatible(Region.MappedRegion->GetMappedPtr(), Region.MappedRegion->GetMappedSize(), GridMetrics.GetPointsPerChunk()))
+	{
+		UE_LOG(LogChunkRegionStore, Warning, TEXT("Ignoring region file %s, it was written for another format or resolution"), *Region.Path);
+		UnmapRegion(Region);
+		Region.bIncompatible = true;
+		return false;
+	}
+	return true;
+}
+
+void FChunkRegionStore::UnmapRegion(FRegion& Region)
+{
+	// The region has to go before the handle it was mapped from
+	Region.MappedRegion.Reset();
+	Region.MappedFile.Reset();
+}
+
+bool FChunkRegionStore::ReadChunk(const FIntVector& Coord, TArray<uint8>& OutBlob, uint32* OutSequence)
+{
+	FScopeLock ScopeLock(&Lock);
+	FRegion& Region = FindOrAddRegion(Coord);
+	if (!MapRegion(Region))
+	{
+		return false;
+	}
+
+	const uint8* Mapped = Region.MappedRegion->GetMappedPtr();
+	MarchingCore::RegionFile::Entry Entry;
+	if (!MarchingCore::RegionFile::ReadEntry(Mapped, Region.MappedRegion->GetMappedSize(), MarchingCore::RegionFile::GetEntryIndex(Coord.X, Coord.Y, Coord.Z), Entry))
+	{
+		return false;
+	}
+
+	OutBlob.SetNumUninitialized(Entry.Size);
+	FMemory::Memcpy(OutBlob.GetData(), Mapped + Entry.Offset, Entry.Size);
+	if (OutSequence)
+	{
+		*OutSequence = Entry.Sequence;
+	}
+	return true;
+}
+
+bool FChunkRegionStore::CreateRegionFile(FRegion& Region)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*Directory);
+
+	TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*Region.Path));
+	if (!File)
+	{
+		return false;
+	}
+
+	// The header and an empty table, blobs are appended after it
+	TArray<uint8> Empty;
+	Empty.SetNumZeroed(MarchingCore::RegionFile::DataOffset);
+	MarchingCore::RegionFile::Header Header;
+	Header.PointsPerChunk = GridMetrics.GetPointsPerChunk();
+	FMemory::Memcpy(Empty.GetData(), &Header, sizeof(Header));
+	Region.bMissing = false;
+	Region.FileSize = Empty.Num();
+	return File->Write(Empty.GetData(), Empty.Num());
+}
+
+bool FChunkRegionStore::WriteChunk(const FIntVector& Coord, const MarchingCore::CompactDensity& Density, uint32 Sequence)
+{
+	std::vector<uint8_t> Serialized;
+	Density.Serialize(Serialized);
+
+	// The blob is the uncompressed size followed by the zlib stream
+	const int32 UncompressedSize = static_cast<int32>(Serialized.size());
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, UncompressedSize);
+	TArray<uint8> Blob;
+	Blob.SetNumUninitialized(sizeof(uint32) + CompressedSize);
+	FMemory::Memcpy(Blob.GetData(), &UncompressedSize, sizeof(uint32));
+	if (!FCompression::CompressMemory(NAME_Zlib, Blob.GetData() + sizeof(uint32), CompressedSize, Serialized.data(), UncompressedSize))
+	{
+		return false;
+	}
+	Blob.SetNum(sizeof(uint32) + CompressedSize, false);
+
+	MarchingCore::RegionFile::Entry Entry;
+	const int EntryIndex = MarchingCore::RegionFile::GetEntryIndex(Coord.X, Coord.Y, Coord.Z);
+	const uint32 EntryOffset = MarchingCore::RegionFile::GetEntryOffset(EntryIndex);
+	FString Path;
+	bool bNewSlot = false;
+	{
+		FScopeLock ScopeLock(&Lock);
+		FRegion& Region = FindOrAddRegion(Coord);
+		if (Region.bIncompatible)
+		{
+			return false;
+		}
+		if (MapRegion(Region))
+		{
+			FMemory::Memcpy(&Entry, Region.MappedRegion->GetMappedPtr() + EntryOffset, sizeof(Entry));
+		}
+		else if (Region.bIncompatible || !CreateRegionFile(Region))
+		{
+			return false;
+		}
+		Path = Region.Path;
+
+		// Write into the slot the entry doesn't point at, a bigger one is reserved at the end of the file
+		if (Entry.SpareOffset == 0 || Entry.SpareCapacity < static_cast<uint32>(Blob.Num()))
+		{
+			Entry.SpareOffset = static_cast<uint32>(FMath::Max<int64>(Region.FileSize, MarchingCore::RegionFile::DataOffset));
+			Entry.SpareCapacity = MarchingCore::RegionFile::AlignCapacity(Blob.Num());
+			Region.FileSize = static_cast<int64>(Entry.SpareOffset) + Entry.SpareCapacity;
+			bNewSlot = true;
+		}
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*Path, true, true));
+	if (!File)
+	{
+		return false;
+	}
+
+	// The blob is on disk before the entry points at it, so a crash in between leaves the entry on the previous blob
+	if (bNewSlot)
+	{
+		Blob.SetNumZeroed(Entry.SpareCapacity);
+	}
+	if (!WriteAt(*File, Entry.SpareOffset, Blob.GetData(), Blob.Num()) || !File->Flush(true))
+	{
+		return false;
+	}
+
+	Swap(Entry.Offset, Entry.SpareOffset);
+	Swap(Entry.Capacity, Entry.SpareCapacity);
+	Entry.Size = sizeof(uint32) + CompressedSize;
+	Entry.Sequence = Sequence;
+
+	// Only the flip of the entry is done under the lock, a read never sees half of it. The mapping is dropped so the next
+	// read maps the file again with the grown size.
+	FScopeLock ScopeLock(&Lock);
+	UnmapRegion(FindOrAddRegion(Coord));
+	const bool bWritten = WriteAt(*File, EntryOffset, &Entry, sizeof(Entry));
+	File->Flush(true);
+	return bWritten;
+}
+
+bool FChunkRegionStore::DecodeChunk(const TArray<uint8>& Blob, int PointsPerChunk, float* OutDensity, bool* OutExact)
+{
+	uint32 UncompressedSize = 0;
+	if (!MarchingCore::RegionFile::ReadUncompressedSize(Blob.GetData(), Blob.Num(), PointsPerChunk, UncompressedSize))
+	{
+		return false;
+	}
+
+	TArray<uint8> Serialized;
+	Serialized.SetNumUninitialized(UncompressedSize);
+	if (!FCompression::UncompressMemory(NAME_Zlib, Serialized.GetData(), UncompressedSize, Blob.GetData() + sizeof(uint32), Blob.Num() - sizeof(uint32)))
+	{
+		return false;
+	}
+
+	MarchingCore::CompactDensity Density;
+	if (!Density.Deserialize(Serialized.GetData(), Serialized.Num()) || Density.GetPointsPerAxis() != PointsPerChunk)
+	{
+		return false;
+	}
+	Density.Decompress(OutDensity);
+	if (OutExact)
+	{
+		*OutExact = Density.IsExact();
+	}
+	return true;
+}
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/CompactDensity.h"
+#include "Core/RegionFile.h"
+#include "HAL/CriticalSection.h"
+#include "Utility/GridMetrics.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// Saves the density of edited chunks to region files in Directory, one per RegionFile::ChunksPerAxis^3 chunks, and reads
+// them back through memory mapping. Only chunks handed to WriteChunk get a blob, each zlib compressed on its own, so
+// saving and loading cost I/O in proportion to the edited area.
+// Reads on the game thread and the journal compaction writing on a task share a lock that only guards the mapping and
+// the table, blobs are written and flushed outside it. The blobs it hands out are decoded on any thread with DecodeChunk.
+class MARCHINGCUBES_API FChunkRegionStore
+{
+public:
+	FChunkRegionStore(const FString& InDirectory, const FGridMetrics& InGridMetrics);
+	~FChunkRegionStore();
+
+	// Copies the compressed blob of the chunk at Coord and the sequence of the last edit folded into it, false when it
+	// was never saved
+	bool ReadChunk(const FIntVector& Coord, TArray<uint8>& OutBlob, uint32* OutSequence = nullptr);
+	// Saves the chunk at Coord with every journal edit up to Sequence folded in, only its blob and table entry are written.
+	// The previous blob stays untouched until the new one is on disk.
+	bool WriteChunk(const FIntVector& Coord, const MarchingCore::CompactDensity& Density, uint32 Sequence);
+
+	// Decodes a blob from ReadChunk into OutDensity of PointsPerChunk^3 points. OutExact is false for blobs saved quantized,
+	// which don't match what the neighbours compute for their shared border.
+	static bool DecodeChunk(const TArray<uint8>& Blob, int PointsPerChunk, float* OutDensity, bool* OutExact = nullptr);
+
+private:
+	struct FRegion
+	{
+		FString Path;
+		// Mapped on the first read after a write, writes drop the mapping because they may grow the file
+		TUniquePtr<IMappedFileHandle> MappedFile;
+		TUniquePtr<IMappedFileRegion> MappedRegion;
+		// End of the file including the slots handed out to writes still in flight, new slots are appended here
+		int64 FileSize = 0;
+		bool bMissing = false;
+		bool bIncompatible = false;
+	};
+
+	FRegion& FindOrAddRegion(const FIntVector& Coord);
+	// Maps the region file, false when it doesn't exist or was written for another resolution
+	bool MapRegion(FRegion& Region);
+	void UnmapRegion(FRegion& Region);
+	bool CreateRegionFile(FRegion& Region);
+
+	FString Directory;
+	FGridMetrics GridMetrics;
+	TMap<FIntVector, TUniquePtr<FRegion>> Regions;
+	FCriticalSection Lock;
+};
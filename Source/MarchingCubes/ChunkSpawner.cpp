@@ -3,53 +3,498 @@
 
 #include "ChunkSpawner.h"
 
+#include "Core/MeshSkirts.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/Paths.h"
+
+
+namespace
+{
+	const FIntVector FaceOffsets[] =
+	{
+		FIntVector(-1, 0, 0), FIntVector(1, 0, 0),
+		FIntVector(0, -1, 0), FIntVector(0, 1, 0),
+		FIntVector(0, 0, -1), FIntVector(0, 0, 1)
+	};
+}
 
 AChunkSpawner::AChunkSpawner()
 {
-	PrimaryActorTick.bCanEverTick = false;
+	PrimaryActorTick.bCanEverTick = true;
 
 }
 
 void AChunkSpawner::BeginPlay()
 {
 	Super::BeginPlay();
-	SpawnChunk();
-	
+
+	const AMarchingChunk* ChunkDefaults = ChunkBP ? ChunkBP->GetDefaultObject<AMarchingChunk>() : GetDefault<AMarchingChunk>();
+	GridMetrics = ChunkDefaults->GridMetrics;
+	TerrainGenerator = MakeShared<const FTerrainGenerator>(ChunkDefaults->MakeTerrainSettings(), GridMetrics);
+
+	if (bPersistEdits)
+	{
+		const FString SaveDirectory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Terrain"), SaveName);
+		RegionStore = MakeShared<FChunkRegionStore>(SaveDirectory, GridMetrics);
+		EditJournal = MakeUnique<FChunkEditJournal>(FPaths::Combine(SaveDirectory, TEXT("Edits.journal")), RegionStore.ToSharedRef(),
+			TerrainGenerator.ToSharedRef(), GridMetrics, ChunkDefaults->IsoLevel);
+		// Whatever the last session left in the journal is folded right away, chunks replay it until that is done
+		EditJournal->Compact();
+	}
+
+	if (bCacheMeshes)
+	{
+		MeshCache = MakeShared<const FChunkMeshCache>(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MeshCache")));
+	}
+
+	CollisionSubsystem = bDeferCollision ? GetWorld()->GetSubsystem<UChunkCollisionSubsystem>() : nullptr;
+	if (CollisionSubsystem)
+	{
+		CollisionSubsystem->SetPolicy(CollisionPolicy);
+	}
+
+	SetActorTickEnabled(bStreamChunks || DensityStorage != EDensityStorage::Float || EditJournal.IsValid());
+	if (!bStreamChunks)
+	{
+		SpawnChunks();
+	}
+}
+
+void AChunkSpawner::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// The logged strokes are all there is to save, they are folded into the region files when the world loads again
+	if (EditJournal)
+	{
+		EditJournal->Flush();
+		EditJournal.Reset();
+	}
+	RegionStore.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AChunkSpawner::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (bStreamChunks)
+	{
+		UpdateStreaming();
+	}
+	if (DensityStorage != EDensityStorage::Float)
+	{
+		UpdateDensityStorage();
+	}
+	if (EditJournal)
+	{
+		EditJournal->Flush();
+		if (EditJournal->GetNumPendingEdits() >= JournalCompactionThreshold && !EditJournal->IsCompacting())
+		{
+			EditJournal->Compact();
+		}
+	}
+}
+
+void AChunkSpawner::SpawnChunks()
+{
+	for (int z = -VerticalViewRadius; z <= VerticalViewRadius; z++)
+	{
+		for (int x = -ViewRadius; x <= ViewRadius; x++)
+		{
+			for (int y = -ViewRadius; y <= ViewRadius; y++)
+			{
+				SpawnChunk(FIntVector(x, y, z));
+			}
+		}
+	}
 }
 
-void AChunkSpawner::SpawnChunk()
+void AChunkSpawner::UpdateStreaming()
+{
+	// Follow the player pawn, fall back to the spawner itself when there is none (e.g. while possessing nothing)
+	APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+	const FVector ViewLocation = PlayerPawn ? PlayerPawn->GetActorLocation() : GetActorLocation();
+	const FIntVector Center = WorldToChunkCoord(ViewLocation);
+	StreamingCenter = Center;
+
+	// Retire chunks that left the view radius, with some padding so walking along a border doesn't thrash
+	const int UnloadRadius = ViewRadius + UnloadPadding;
+	const int VerticalUnloadRadius = VerticalViewRadius + UnloadPadding;
+	for (auto It = LoadedChunks.CreateIterator(); It; ++It)
+	{
+		const FIntVector Offset = It.Key() - Center;
+		if (FMath::Max(FMath::Abs(Offset.X), FMath::Abs(Offset.Y)) > UnloadRadius || FMath::Abs(Offset.Z) > VerticalUnloadRadius)
+		{
+			RetireChunk(It.Value());
+			It.RemoveCurrent();
+		}
+	}
+
+	// Collect the missing chunks in the view radius and generate the closest ones first
+	TArray<FIntVector> Missing;
+	for (int z = -VerticalViewRadius; z <= VerticalViewRadius; z++)
+	{
+		for (int x = -ViewRadius; x <= ViewRadius; x++)
+		{
+			for (int y = -ViewRadius; y <= ViewRadius; y++)
+			{
+				const FIntVector Coord = Center + FIntVector(x, y, z);
+				if (!LoadedChunks.Contains(Coord))
+				{
+					Missing.Add(Coord);
+				}
+			}
+		}
+	}
+	Missing.Sort([Center](const FIntVector& A, const FIntVector& B)
+	{
+		const FIntVector OffsetA = A - Center;
+		const FIntVector OffsetB = B - Center;
+		return OffsetA.X * OffsetA.X + OffsetA.Y * OffsetA.Y + OffsetA.Z * OffsetA.Z
+			< OffsetB.X * OffsetB.X + OffsetB.Y * OffsetB.Y + OffsetB.Z * OffsetB.Z;
+	});
+
+	const int NumToSpawn = FMath::Min(Missing.Num(), MaxChunkSpawnsPerTick);
+	for (int i = 0; i < NumToSpawn; i++)
+	{
+		SpawnChunk(Missing[i]);
+	}
+
+	if (bUseLOD)
+	{
+		UpdateLODs();
+	}
+}
+
+int AChunkSpawner::GetLODStride(const FIntVector& Coord) const
+{
+	// Horizontal distance only, so a whole column shares one stride and skirts are only needed on the side faces
+	const FIntVector Offset = Coord - StreamingCenter;
+	const int Distance = FMath::Max(FMath::Abs(Offset.X), FMath::Abs(Offset.Y));
+	if (!bUseLOD || Distance <= FullDetailRadius)
+	{
+		return 1;
+	}
+	const int Level = 1 + (Distance - FullDetailRadius - 1) / LODRingWidth;
+	return FMath::Min(1 << FMath::Min(Level, 3), MaxLODStride);
+}
+
+uint8 AChunkSpawner::GetSkirtFaces(const FIntVector& Coord) const
+{
+	// Both chunks on a stride boundary hang a skirt, whichever surface ends higher is covered down to the other one
+	const int Stride = GetLODStride(Coord);
+	uint8 Faces = 0;
+	for (int Axis = 0; Axis < 2; Axis++)
+	{
+		for (const bool bPositive : { false, true })
+		{
+			FIntVector Neighbour = Coord;
+			Neighbour[Axis] += bPositive ? 1 : -1;
+			if (GetLODStride(Neighbour) != Stride)
+			{
+				Faces |= MarchingCore::MeshSkirts::GetFaceBit(Axis, bPositive);
+			}
+		}
+	}
+	return Faces;
+}
+
+void AChunkSpawner::UpdateLODs()
+{
+	int NumUpdates = 0;
+	for (const TPair<FIntVector, AMarchingChunk*>& Pair : LoadedChunks)
+	{
+		if (NumUpdates >= MaxLODUpdatesPerTick)
+		{
+			break;
+		}
+
+		AMarchingChunk* Chunk = Pair.Value;
+		const int Stride = GetLODStride(Pair.Key);
+		const uint8 SkirtFaces = GetSkirtFaces(Pair.Key);
+		if (!Chunk || Chunk->IsGenerating() || (Chunk->GetLODStride() == Stride && Chunk->GetSkirtFaces() == SkirtFaces))
+		{
+			continue;
+		}
+
+		Chunk->SetLOD(Stride, SkirtFaces);
+		if (Chunk->IsDensityQuantized() && CanRefillChunk(*Chunk))
+		{
+			// Quantized density no longer matches the neighbours on the shared borders, the chunk starts over from its sources
+			GenerateChunk(Chunk, Pair.Key);
+		}
+		// The chunk keeps its density and edits, only the mesh is built again
+		else if (bAsyncGeneration)
+		{
+			Chunk->GenerateAsync(false);
+		}
+		else
+		{
+			Chunk->BuildBrickSummary();
+			Chunk->Initialize();
+		}
+		NumUpdates++;
+	}
+}
+
+void AChunkSpawner::UpdateDensityStorage()
+{
+	const MarchingCore::DensityEncoding Quantization = DensityStorage == EDensityStorage::Quantized8
+		? MarchingCore::DensityEncoding::Quantized8 : MarchingCore::DensityEncoding::Quantized16;
+
+	int NumUpdates = 0;
+	for (const TPair<FIntVector, AMarchingChunk*>& Pair : LoadedChunks)
+	{
+		if (NumUpdates >= MaxDensityCompressionsPerTick)
+		{
+			break;
+		}
+
+		AMarchingChunk* Chunk = Pair.Value;
+		const FIntVector Offset = Pair.Key - StreamingCenter;
+		const int Distance = FMath::Max3(FMath::Abs(Offset.X), FMath::Abs(Offset.Y), FMath::Abs(Offset.Z));
+		if (!Chunk || Chunk->IsGenerating())
+		{
+			continue;
+		}
+
+		// Chunks coming back close to the player are edited and remeshed at full resolution, which needs the exact density
+		if (Distance <= ExpandedDensityRadius)
+		{
+			if (Chunk->IsDensityQuantized() && CanRefillChunk(*Chunk))
+			{
+				GenerateChunk(Chunk, Pair.Key);
+				NumUpdates++;
+			}
+			continue;
+		}
+		if (Chunk->IsDensityCompressed())
+		{
+			continue;
+		}
+
+		Chunk->CompressDensity(Quantization);
+		NumUpdates++;
+	}
+}
+
+bool AChunkSpawner::CanRefillChunk(const AMarchingChunk& Chunk) const
+{
+	// Without a journal, strokes only live in the chunk's own density
+	return EditJournal.IsValid() || !Chunk.HasDensityEdits();
+}
+
+void AChunkSpawner::RecordEdit(const MarchingCore::BrushEdit& Edit)
+{
+	if (EditJournal)
+	{
+		EditJournal->Append(Edit);
+	}
+}
+
+AMarchingChunk* AChunkSpawner::FindChunk(const FIntVector& Coord) const
+{
+	AMarchingChunk* const* Found = LoadedChunks.Find(Coord);
+	return Found ? *Found : nullptr;
+}
+
+FIntVector AChunkSpawner::WorldToChunkCoord(const FVector& Location) const
+{
+	// Neighbouring chunks share their border points, so a chunk spans one point less than it has
+	const float ChunkSize = (GridMetrics.GetPointsPerChunk() - 1) * GridMetrics.GetDistance();
+	return FIntVector(FMath::FloorToInt(Location.X / ChunkSize), FMath::FloorToInt(Location.Y / ChunkSize),
+		FMath::FloorToInt(Location.Z / ChunkSize));
+}
+
+AMarchingChunk* AChunkSpawner::SpawnChunk(const FIntVector& Coord)
 {
 	UWorld* World = GetWorld();
 	if (World)
 	{
-		FActorSpawnParameters SpawnParams;
-		SpawnParams.Owner = this;
-		SpawnParams.Instigator = GetInstigator();
-		
-		float Dist = 100 * (32 - 1);
+		const float Dist = (GridMetrics.GetPointsPerChunk() - 1) * GridMetrics.GetDistance();
 
-		int Iterations = 3;
-		
-		for (int x = -Iterations; x <= Iterations; x++)
+		// Set the location and rotation where you want to spawn the actor
+		FVector SpawnLocation = FVector(Coord) * Dist;
+		FRotator SpawnRotation = FRotator::ZeroRotator;
+
+		// Prefer recycling a retired chunk, it already owns its component and buffers
+		SpawnedChunk = AcquirePooledChunk();
+		if (SpawnedChunk)
+		{
+			SpawnedChunk->SetActorLocationAndRotation(SpawnLocation, SpawnRotation);
+			SpawnedChunk->ReturnFromPool();
+		}
+		else
 		{
-			for (int y = -Iterations; y <= Iterations; y++)
+			FActorSpawnParameters SpawnParams;
+			SpawnParams.Owner = this;
+			SpawnParams.Instigator = GetInstigator();
+
+			SpawnedChunk = World->SpawnActor<AMarchingChunk>(ChunkBP, SpawnLocation, SpawnRotation, SpawnParams);
+		}
+
+		if (SpawnedChunk)
+		{
+			SpawnedChunk->InitialX = Coord.X;
+			SpawnedChunk->InitialY = Coord.Y;
+			SpawnedChunk->InitialZ = Coord.Z;
+			SpawnedChunk->SetTerrainGenerator(TerrainGenerator);
+			SpawnedChunk->SetLOD(GetLODStride(Coord), GetSkirtFaces(Coord));
+			LoadedChunks.Add(Coord, SpawnedChunk);
+			if (CollisionSubsystem)
 			{
-				// Set the location and rotation where you want to spawn the actor
-				FVector SpawnLocation = FVector(x * Dist, y * Dist, 0.f);
-				FRotator SpawnRotation = FRotator::ZeroRotator;
-        
-				SpawnedChunk = World->SpawnActor<AMarchingChunk>(ChunkBP, SpawnLocation, SpawnRotation, SpawnParams);
-				if (SpawnedChunk)
-				{
-					SpawnedChunk->InitialX = x;
-					SpawnedChunk->InitialY = y;
+				CollisionSubsystem->RegisterChunk(SpawnedChunk);
+			}
 
-					SpawnedChunk->PopulateTerrainMap();
-					SpawnedChunk->Initialize();
-					SpawnedChunk->UpdateMesh();
+			if (bBatchRegions)
+			{
+				if (AMarchingRegion* Region = FindOrSpawnRegion(Coord))
+				{
+					Region->AddChunk(Coord, SpawnedChunk);
+					SpawnedChunk->SetRegion(Region);
 				}
 			}
+
+			GenerateChunk(SpawnedChunk, Coord);
+		}
+		return SpawnedChunk;
+	}
+	return nullptr;
+}
+
+void AChunkSpawner::GenerateChunk(AMarchingChunk* Chunk, const FIntVector& Coord)
+{
+	// Neighbours that are done generating hand over the border planes they share with the chunk, strokes on them included
+	bool bEdited = false;
+	for (const FIntVector& Offset : FaceOffsets)
+	{
+		const AMarchingChunk* Neighbour = FindChunk(Coord + Offset);
+		if (Neighbour && Neighbour->CanShareBorders())
+		{
+			Chunk->CopySharedBorder(*Neighbour, Offset);
+			bEdited |= Neighbour->HasDensityEdits();
+		}
+	}
+
+	// Edited chunks come back from their region file, with the logged strokes that aren't folded into it yet
+	if (EditJournal)
+	{
+		TArray<uint8> SavedDensity;
+		uint32 SavedSequence = 0;
+		if (RegionStore->ReadChunk(Coord, SavedDensity, &SavedSequence))
+		{
+			Chunk->SetSavedDensity(MoveTemp(SavedDensity));
+			bEdited = true;
+		}
+		TArray<MarchingCore::BrushEdit> Edits;
+		EditJournal->GetEditsAfter(Coord, SavedSequence, Edits);
+		bEdited |= Edits.Num() > 0;
+		Chunk->SetReplayedEdits(MoveTemp(Edits));
+	}
+	// The others are the same for everyone with these settings, their mesh may come from the cache
+	Chunk->SetMeshCache(bEdited ? TSharedPtr<const FChunkMeshCache>() : MeshCache);
+
+	if (bAsyncGeneration)
+	{
+		// The chunk shows up once its background generation commits
+		Chunk->GenerateAsync();
+	}
+	else
+	{
+		// Either way the buffers hold the finished mesh, normals included, and only need a section built
+		if (Chunk->LoadCachedMesh(true))
+		{
+			Chunk->ConstructMesh();
+		}
+		else
+		{
+			Chunk->PopulateTerrainMap();
+			Chunk->Initialize();
+			Chunk->StoreCachedMesh();
 		}
 	}
 }
 
+void AChunkSpawner::RetireChunk(AMarchingChunk* Chunk)
+{
+	if (!Chunk)
+	{
+		return;
+	}
+
+	if (CollisionSubsystem)
+	{
+		CollisionSubsystem->UnregisterChunk(Chunk);
+	}
+
+	// Empty regions go away with their last chunk
+	if (AMarchingRegion* Region = Chunk->GetRegion())
+	{
+		const FIntVector Coord = Chunk->GetChunkCoord();
+		Region->RemoveChunk(Coord);
+		Chunk->SetRegion(nullptr);
+		if (Region->IsEmpty())
+		{
+			Regions.Remove(AMarchingRegion::ChunkToRegionCoord(Coord, RegionSize));
+			Region->Destroy();
+		}
+	}
+
+	if (ChunkPool.Num() < MaxPooledChunks)
+	{
+		Chunk->ReleaseToPool();
+		ChunkPool.Add(Chunk);
+	}
+	else
+	{
+		Chunk->Destroy();
+	}
+}
+
+AMarchingChunk* AChunkSpawner::AcquirePooledChunk()
+{
+	// A chunk retired while generating can only be reused once its background tasks are done with its buffers
+	for (int32 i = ChunkPool.Num() - 1; i >= 0; i--)
+	{
+		AMarchingChunk* Chunk = ChunkPool[i];
+		if (!IsValid(Chunk))
+		{
+			ChunkPool.RemoveAtSwap(i);
+		}
+		else if (!Chunk->IsGenerating())
+		{
+			ChunkPool.RemoveAtSwap(i);
+			return Chunk;
+		}
+	}
+	return nullptr;
+}
+
+AMarchingRegion* AChunkSpawner::FindOrSpawnRegion(const FIntVector& ChunkCoord)
+{
+	const FIntVector RegionCoord = AMarchingRegion::ChunkToRegionCoord(ChunkCoord, RegionSize);
+	if (AMarchingRegion** Found = Regions.Find(RegionCoord))
+	{
+		return *Found;
+	}
+
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	// A region sits where its first chunk would, its sections are offset from there
+	const float Dist = (GridMetrics.GetPointsPerChunk() - 1) * GridMetrics.GetDistance();
+	const FVector SpawnLocation = FVector(RegionCoord * RegionSize) * Dist;
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = this;
+
+	AMarchingRegion* Region = World->SpawnActor<AMarchingRegion>(AMarchingRegion::StaticClass(), SpawnLocation, FRotator::ZeroRotator, SpawnParams);
+	if (Region)
+	{
+		Region->Setup(RegionCoord, RegionSize, GridMetrics);
+		Regions.Add(RegionCoord, Region);
+	}
+	return Region;
+}
@@ -4,10 +4,27 @@
 
 #include "CoreMinimal.h"
 #include "MarchingChunk.h"
+#include "MarchingRegion.h"
+#include "ChunkCollisionSubsystem.h"
+#include "ChunkEditJournal.h"
+#include "ChunkMeshCache.h"
+#include "ChunkRegionStore.h"
 #include "Utility/GridMetrics.h"
 #include "GameFramework/Actor.h"
 #include "ChunkSpawner.generated.h"
 
+// How loaded chunks away from the player keep their density
+UENUM()
+enum class EDensityStorage : uint8
+{
+	// Floats, 4 bytes per point
+	Float,
+	// Offsets from the iso level in 16 bits, close to lossless
+	Quantized16,
+	// Offsets from the iso level in 8 bits, finest near the surface
+	Quantized8
+};
+
 UCLASS()
 class MARCHINGCUBES_API AChunkSpawner : public AActor
 {
@@ -15,11 +32,40 @@ class MARCHINGCUBES_API AChunkSpawner : public AActor
 	
 public:	
 	AChunkSpawner();
-	// virtual void Tick(float DeltaTime) override;
+	virtual void Tick(float DeltaTime) override;
+
+	// Loaded chunk at Coord, nullptr when there is none
+	AMarchingChunk* FindChunk(const FIntVector& Coord) const;
+	// Logs a brush stroke that was applied to the loaded chunks, so it reaches the chunks loaded later and the next session
+	void RecordEdit(const MarchingCore::BrushEdit& Edit);
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Spawns the whole block of chunks around the origin once, used when streaming is disabled
+	void SpawnChunks();
+	AMarchingChunk* SpawnChunk(const FIntVector& Coord);
+	// Fills the chunk at Coord from its neighbours' borders, its saved density and its logged edits or the noise, and meshes it
+	void GenerateChunk(AMarchingChunk* Chunk, const FIntVector& Coord);
+	// GenerateChunk would bring back everything the chunk holds, including its strokes
+	bool CanRefillChunk(const AMarchingChunk& Chunk) const;
+	// Returns the chunk to the pool, or destroys it when the pool is full
+	void RetireChunk(AMarchingChunk* Chunk);
+	AMarchingChunk* AcquirePooledChunk();
+	// Region drawing the chunk at ChunkCoord, spawned when its first chunk is loaded
+	AMarchingRegion* FindOrSpawnRegion(const FIntVector& ChunkCoord);
 
-	void SpawnChunk();
+	// Loads the chunks in view of the player pawn and retires the ones that fell out of it
+	void UpdateStreaming();
+	FIntVector WorldToChunkCoord(const FVector& Location) const;
+	// Stride the chunk at Coord is marched at, from its horizontal distance to the streaming center
+	int GetLODStride(const FIntVector& Coord) const;
+	// Side faces of the chunk at Coord towards a neighbour of another stride, the ones that get skirts
+	uint8 GetSkirtFaces(const FIntVector& Coord) const;
+	// Re-meshes loaded chunks whose stride or skirts changed since the streaming center moved
+	void UpdateLODs();
+	// Compresses the density of loaded chunks outside ExpandedDensityRadius, and fills quantized ones inside it again
+	void UpdateDensityStorage();
 
 private:
 	UPROPERTY(VisibleAnywhere, Category = "Spawning")
@@ -28,5 +74,122 @@ private:
 	UPROPERTY(EditAnywhere, Category = "Spawning")
 	TSubclassOf<AMarchingChunk> ChunkBP;
 
-	FGridMetrics* GridMetrics;
+	// Generate chunks on background tasks instead of blocking BeginPlay until all of them are meshed
+	UPROPERTY(EditAnywhere, Category = "Spawning")
+	bool bAsyncGeneration = true;
+
+	// Keep loading and unloading chunks around the player instead of spawning a fixed square once
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+	bool bStreamChunks = true;
+
+	// Number of chunks loaded in every horizontal direction from the chunk the player is in
+	UPROPERTY(EditAnywhere, Category = "Streaming", meta = (ClampMin = "0"))
+	int ViewRadius = 3;
+
+	// Number of chunks loaded above and below the chunk the player is in
+	UPROPERTY(EditAnywhere, Category = "Streaming", meta = (ClampMin = "0"))
+	int VerticalViewRadius = 1;
+
+	// Extra chunks a loaded chunk may be away before it is retired
+	UPROPERTY(EditAnywhere, Category = "Streaming", meta = (ClampMin = "0"))
+	int UnloadPadding = 1;
+
+	// Limits how many chunks start generating per frame
+	UPROPERTY(EditAnywhere, Category = "Streaming", meta = (ClampMin = "1"))
+	int MaxChunkSpawnsPerTick = 4;
+
+	// Number of retired chunks kept around for reuse instead of being destroyed
+	UPROPERTY(EditAnywhere, Category = "Streaming", meta = (ClampMin = "0"))
+	int MaxPooledChunks = 16;
+
+	UPROPERTY(VisibleAnywhere, Category = "Streaming")
+	TMap<FIntVector, AMarchingChunk*> LoadedChunks;
+
+	UPROPERTY(VisibleAnywhere, Category = "Streaming")
+	TArray<AMarchingChunk*> ChunkPool;
+
+	// Chunk the player is in, the center of the view radius and of the LOD rings
+	FIntVector StreamingCenter = FIntVector::ZeroValue;
+
+	// March distant chunks at a coarser stride, with skirts hiding the cracks where the stride changes
+	UPROPERTY(EditAnywhere, Category = "LOD")
+	bool bUseLOD = false;
+
+	// Chunks this many chunks or closer to the streaming center horizontally are marched at full resolution
+	UPROPERTY(EditAnywhere, Category = "LOD", meta = (ClampMin = "0", EditCondition = "bUseLOD"))
+	int FullDetailRadius = 2;
+
+	// Every further ring of this many chunks doubles the stride
+	UPROPERTY(EditAnywhere, Category = "LOD", meta = (ClampMin = "1", EditCondition = "bUseLOD"))
+	int LODRingWidth = 2;
+
+	UPROPERTY(EditAnywhere, Category = "LOD", meta = (ClampMin = "1", ClampMax = "8", EditCondition = "bUseLOD"))
+	int MaxLODStride = 8;
+
+	// Limits how many loaded chunks are meshed again per frame after their stride changed
+	UPROPERTY(EditAnywhere, Category = "LOD", meta = (ClampMin = "1", EditCondition = "bUseLOD"))
+	int MaxLODUpdatesPerTick = 2;
+
+	// Chunks away from the player keep their density in this format, they decode it again when they are edited or meshed.
+	// Chunks filled from the height shaping only are always stored exactly, with one value per layer.
+	UPROPERTY(EditAnywhere, Category = "Memory")
+	EDensityStorage DensityStorage = EDensityStorage::Float;
+
+	// Chunks this many chunks or closer to the streaming center keep their floats, so brush strokes don't wait for a decode
+	UPROPERTY(EditAnywhere, Category = "Memory", meta = (ClampMin = "0", EditCondition = "DensityStorage != EDensityStorage::Float"))
+	int ExpandedDensityRadius = 1;
+
+	// Limits how many chunks are compressed or filled again per frame
+	UPROPERTY(EditAnywhere, Category = "Memory", meta = (ClampMin = "1", EditCondition = "DensityStorage != EDensityStorage::Float"))
+	int MaxDensityCompressionsPerTick = 8;
+
+	// Log brush strokes to a journal that is folded into region files in the background, and load edited chunks back
+	// from there instead of the noise
+	UPROPERTY(EditAnywhere, Category = "Persistence")
+	bool bPersistEdits = false;
+
+	// Folder under Saved/Terrain the journal and region files of this world go to
+	UPROPERTY(EditAnywhere, Category = "Persistence", meta = (EditCondition = "bPersistEdits"))
+	FString SaveName = TEXT("Default");
+
+	// Logged strokes that start a compaction into the region files, fewer means less to replay on load but more rewrites
+	UPROPERTY(EditAnywhere, Category = "Persistence", meta = (ClampMin = "1", EditCondition = "bPersistEdits"))
+	int JournalCompactionThreshold = 256;
+
+	TSharedPtr<FChunkRegionStore> RegionStore;
+	TUniquePtr<FChunkEditJournal> EditJournal;
+
+	// Keep the meshes of chunks that were never edited in Saved/MeshCache, so the next start with the same settings loads
+	// them instead of sampling the noise and meshing again
+	UPROPERTY(EditAnywhere, Category = "Mesh Cache")
+	bool bCacheMeshes = false;
+
+	TSharedPtr<const FChunkMeshCache> MeshCache;
+
+	// Draw cubic blocks of chunks through one region actor each instead of one mesh component per chunk
+	UPROPERTY(EditAnywhere, Category = "Regions")
+	bool bBatchRegions = false;
+
+	// Chunks along each side of a region
+	UPROPERTY(EditAnywhere, Category = "Regions", meta = (ClampMin = "1", EditCondition = "bBatchRegions"))
+	int RegionSize = 4;
+
+	UPROPERTY(VisibleAnywhere, Category = "Regions")
+	TMap<FIntVector, AMarchingRegion*> Regions;
+
+	// Leave collision cooking of spawned chunks to UChunkCollisionSubsystem instead of cooking it with every mesh
+	UPROPERTY(EditAnywhere, Category = "Collision")
+	bool bDeferCollision = true;
+
+	UPROPERTY(EditAnywhere, Category = "Collision", meta = (EditCondition = "bDeferCollision"))
+	FChunkCollisionPolicy CollisionPolicy;
+
+	UPROPERTY()
+	UChunkCollisionSubsystem* CollisionSubsystem;
+
+	// Taken from the chunk class, so chunks of any resolution are spaced correctly
+	FGridMetrics GridMetrics;
+
+	// Built once from the chunk class defaults and shared read-only by every spawned chunk
+	TSharedPtr<const FTerrainGenerator> TerrainGenerator;
 };
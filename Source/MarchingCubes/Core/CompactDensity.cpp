@@ -0,0 +1,258 @@
+#include "CompactDensity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace MarchingCore
+{
+
+namespace
+{
+	constexpr float Max16 = 32767.0f;
+	constexpr float Max8 = 127.0f;
+
+	// Written in front of the values by Serialize
+	struct SerializedHeader
+	{
+		uint8_t Encoding;
+		uint8_t Padding[3];
+		int32_t PointsPerAxis;
+		float IsoLevel;
+		float Range;
+	};
+
+	template<typename T>
+	void AppendValues(std::vector<uint8_t>& Out, const std::vector<T>& Values)
+	{
+		const size_t Offset = Out.size();
+		Out.resize(Offset + Values.size() * sizeof(T));
+		std::memcpy(Out.data() + Offset, Values.data(), Values.size() * sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValues(const uint8_t* Data, size_t Size, size_t Count, std::vector<T>& OutValues)
+	{
+		if (Size != Count * sizeof(T))
+		{
+			return false;
+		}
+		OutValues.resize(Count);
+		std::memcpy(OutValues.data(), Data, Size);
+		return true;
+	}
+
+	// Points below the iso level never round up to it, they would change the case of every cube around them
+	int QuantizeOffset(float Fraction, float MaxValue)
+	{
+		// Rounds half away from zero like lround, without its library call
+		const float Scaled = Fraction * MaxValue;
+		const int Value = static_cast<int>(Scaled + (Scaled < 0.0f ? -0.5f : 0.5f));
+		return Fraction < 0.0f ? std::min(Value, -1) : Value;
+	}
+}
+
+void CompactDensity::Compress(const float* Density, int InPointsPerAxis, float InIsoLevel, DensityEncoding Quantization)
+{
+	Reset();
+	PointsPerAxis = InPointsPerAxis;
+	IsoLevel = InIsoLevel;
+	const int PointsPerLayer = PointsPerAxis * PointsPerAxis;
+	const int NumPoints = PointsPerLayer * PointsPerAxis;
+
+	bool bConstantLayers = true;
+	for (int z = 0; z < PointsPerAxis && bConstantLayers; z++)
+	{
+		const float* Layer = Density + z * PointsPerLayer;
+		bConstantLayers = std::all_of(Layer, Layer + PointsPerLayer, [First = Layer[0]](float Value) { return Value == First; });
+	}
+	if (bConstantLayers)
+	{
+		Encoding = DensityEncoding::Layers;
+		LayerValues.resize(PointsPerAxis);
+		for (int z = 0; z < PointsPerAxis; z++)
+		{
+			LayerValues[z] = Density[z * PointsPerLayer];
+		}
+		return;
+	}
+
+	if (Quantization == DensityEncoding::Float)
+	{
+		Encoding = DensityEncoding::Float;
+		Values32.assign(Density, Density + NumPoints);
+		return;
+	}
+
+	Range = 0.0f;
+	for (int i = 0; i < NumPoints; i++)
+	{
+		Range = std::max(Range, std::abs(Density[i] - IsoLevel));
+	}
+	const float InvRange = 1.0f / Range;
+
+	if (Quantization == DensityEncoding::Quantized8)
+	{
+		Encoding = DensityEncoding::Quantized8;
+		Values8.resize(NumPoints);
+		for (int i = 0; i < NumPoints; i++)
+		{
+			const float Fraction = (Density[i] - IsoLevel) * InvRange;
+			const float Companded = std::copysign(std::sqrt(std::abs(Fraction)), Fraction);
+			Values8[i] = static_cast<int8_t>(QuantizeOffset(Companded, Max8));
+		}
+	}
+	else
+	{
+		Encoding = DensityEncoding::Quantized16;
+		Values16.resize(NumPoints);
+		for (int i = 0; i < NumPoints; i++)
+		{
+			Values16[i] = static_cast<int16_t>(QuantizeOffset((Density[i] - IsoLevel) * InvRange, Max16));
+		}
+	}
+}
+
+float CompactDensity::Decode16(int16_t Value) const
+{
+	const float Decoded = IsoLevel + Value * (Range / Max16);
+	return Value < 0 && Decoded >= IsoLevel ? std::nextafter(IsoLevel, -std::numeric_limits<float>::infinity()) : Decoded;
+}
+
+float CompactDensity::Decode8(int8_t Value) const
+{
+	const float Fraction = Value / Max8;
+	const float Decoded = IsoLevel + std::copysign(Fraction * Fraction, Fraction) * Range;
+	return Value < 0 && Decoded >= IsoLevel ? std::nextafter(IsoLevel, -std::numeric_limits<float>::infinity()) : Decoded;
+}
+
+void CompactDensity::Decompress(float* OutDensity) const
+{
+	const int PointsPerLayer = PointsPerAxis * PointsPerAxis;
+	switch (Encoding)
+	{
+	case DensityEncoding::Layers:
+		for (int z = 0; z < PointsPerAxis; z++)
+		{
+			std::fill_n(OutDensity + z * PointsPerLayer, PointsPerLayer, LayerValues[z]);
+		}
+		break;
+	case DensityEncoding::Float:
+		std::copy(Values32.begin(), Values32.end(), OutDensity);
+		break;
+	case DensityEncoding::Quantized16:
+		std::transform(Values16.begin(), Values16.end(), OutDensity, [this](int16_t Value) { return Decode16(Value); });
+		break;
+	case DensityEncoding::Quantized8:
+		std::transform(Values8.begin(), Values8.end(), OutDensity, [this](int8_t Value) { return Decode8(Value); });
+		break;
+	default:
+		break;
+	}
+}
+
+float CompactDensity::GetValue(int Index) const
+{
+	switch (Encoding)
+	{
+	case DensityEncoding::Layers: return LayerValues[Index / (PointsPerAxis * PointsPerAxis)];
+	case DensityEncoding::Float: return Values32[Index];
+	case DensityEncoding::Quantized16: return Decode16(Values16[Index]);
+	case DensityEncoding::Quantized8: return Decode8(Values8[Index]);
+	default: return IsoLevel;
+	}
+}
+
+void CompactDensity::Reset()
+{
+	Encoding = DensityEncoding::None;
+	LayerValues = std::vector<float>();
+	Values32 = std::vector<float>();
+	Values16 = std::vector<int16_t>();
+	Values8 = std::vector<int8_t>();
+}
+
+void CompactDensity::Serialize(std::vector<uint8_t>& Out) const
+{
+	SerializedHeader Header = {};
+	Header.Encoding = static_cast<uint8_t>(Encoding);
+	Header.PointsPerAxis = PointsPerAxis;
+	Header.IsoLevel = IsoLevel;
+	Header.Range = Range;
+	const size_t Offset = Out.size();
+	Out.resize(Offset + sizeof(Header));
+	std::memcpy(Out.data() + Offset, &Header, sizeof(Header));
+
+	AppendValues(Out, LayerValues);
+	AppendValues(Out, Values32);
+	AppendValues(Out, Values16);
+	AppendValues(Out, Values8);
+}
+
+bool CompactDensity::Deserialize(const uint8_t* Data, size_t Size)
+{
+	Reset();
+	SerializedHeader Header;
+	if (Size < sizeof(Header))
+	{
+		return false;
+	}
+	std::memcpy(&Header, Data, sizeof(Header));
+	if (Header.PointsPerAxis < 2 || Header.PointsPerAxis > 1024)
+	{
+		return false;
+	}
+
+	const uint8_t* Values = Data + sizeof(Header);
+	const size_t ValuesSize = Size - sizeof(Header);
+	const size_t NumPoints = static_cast<size_t>(Header.PointsPerAxis) * Header.PointsPerAxis * Header.PointsPerAxis;
+	bool bValid = false;
+	switch (static_cast<DensityEncoding>(Header.Encoding))
+	{
+	case DensityEncoding::Layers: bValid = ReadValues(Values, ValuesSize, Header.PointsPerAxis, LayerValues); break;
+	case DensityEncoding::Float: bValid = ReadValues(Values, ValuesSize, NumPoints, Values32); break;
+	case DensityEncoding::Quantized16: bValid = ReadValues(Values, ValuesSize, NumPoints, Values16); break;
+	case DensityEncoding::Quantized8: bValid = ReadValues(Values, ValuesSize, NumPoints, Values8); break;
+	default: break;
+	}
+	if (!bValid)
+	{
+		Reset();
+		return false;
+	}
+
+	Encoding = static_cast<DensityEncoding>(Header.Encoding);
+	PointsPerAxis = Header.PointsPerAxis;
+	IsoLevel = Header.IsoLevel;
+	Range = Header.Range;
+	return true;
+}
+
+size_t CompactDensity::GetSerializedSize(DensityEncoding Encoding, int PointsPerAxis)
+{
+	const size_t NumPoints = static_cast<size_t>(PointsPerAxis) * PointsPerAxis * PointsPerAxis;
+	switch (Encoding)
+	{
+	case DensityEncoding::Layers: return sizeof(SerializedHeader) + PointsPerAxis * sizeof(float);
+	case DensityEncoding::Float: return sizeof(SerializedHeader) + NumPoints * sizeof(float);
+	case DensityEncoding::Quantized16: return sizeof(SerializedHeader) + NumPoints * sizeof(int16_t);
+	case DensityEncoding::Quantized8: return sizeof(SerializedHeader) + NumPoints * sizeof(int8_t);
+	default: return sizeof(SerializedHeader);
+	}
+}
+
+bool CompactDensity::IsSerializedSize(size_t Size, int PointsPerAxis)
+{
+	return Size == GetSerializedSize(DensityEncoding::Layers, PointsPerAxis)
+		|| Size == GetSerializedSize(DensityEncoding::Float, PointsPerAxis)
+		|| Size == GetSerializedSize(DensityEncoding::Quantized16, PointsPerAxis)
+		|| Size == GetSerializedSize(DensityEncoding::Quantized8, PointsPerAxis);
+}
+
+size_t CompactDensity::GetAllocatedSize() const
+{
+	return (LayerValues.capacity() + Values32.capacity()) * sizeof(float) + Values16.capacity() * sizeof(int16_t) + Values8.capacity() * sizeof(int8_t);
+}
+
+}
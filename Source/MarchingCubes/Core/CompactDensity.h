@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MarchingCore
+{
+
+// How a density grid is kept while nothing marches or edits it
+enum class DensityEncoding : uint8_t
+{
+	// Nothing stored, the owner keeps its floats
+	None,
+	// Every z layer holds a single value, like the chunks filled from the height shaping only. Exact, one float per layer.
+	Layers,
+	// Offsets from the iso level, linearly quantized to 16 bits over the largest offset in the grid
+	Quantized16,
+	// Offsets from the iso level in 8 bits, companded by a square root so points near the surface keep the most precision
+	Quantized8,
+	// Every point as it is, for grids that must decode exactly like saved snapshots
+	Float
+};
+
+// Compact copy of a PointsPerAxis^3 density grid, indexed like the grid.
+// Quantized points always decode on the side of the iso level they were on, so every cube keeps its case and the marched
+// mesh keeps its topology, only its vertices move slightly along their edges.
+class CompactDensity
+{
+public:
+	// Stores Density as Layers when every layer is constant, otherwise in Quantization (Float, Quantized16 or Quantized8)
+	void Compress(const float* Density, int InPointsPerAxis, float InIsoLevel, DensityEncoding Quantization);
+	// Writes all PointsPerAxis^3 points back to OutDensity
+	void Decompress(float* OutDensity) const;
+	// Decodes a single point
+	float GetValue(int Index) const;
+
+	// Drops the stored grid and its allocation
+	void Reset();
+
+	// Appends the stored grid to Out in the byte order of this machine
+	void Serialize(std::vector<uint8_t>& Out) const;
+	// Replaces the stored grid with one written by Serialize, false and empty when Data doesn't hold a valid one
+	bool Deserialize(const uint8_t* Data, size_t Size);
+	// Size Serialize writes for a grid of PointsPerAxis^3 points in Encoding
+	static size_t GetSerializedSize(DensityEncoding Encoding, int PointsPerAxis);
+	// Size is what Serialize writes for a grid of PointsPerAxis^3 points in any encoding, checked before reading a
+	// size from a file and allocating it
+	static bool IsSerializedSize(size_t Size, int PointsPerAxis);
+
+	DensityEncoding GetEncoding() const { return Encoding; }
+	bool IsEmpty() const { return Encoding == DensityEncoding::None; }
+	// Decompress gives back exactly the floats that were compressed
+	bool IsExact() const { return Encoding == DensityEncoding::Layers || Encoding == DensityEncoding::Float; }
+	int GetPointsPerAxis() const { return PointsPerAxis; }
+	size_t GetAllocatedSize() const;
+
+private:
+	float Decode16(int16_t Value) const;
+	float Decode8(int8_t Value) const;
+
+	DensityEncoding Encoding = DensityEncoding::None;
+	int PointsPerAxis = 0;
+	float IsoLevel = 0.0f;
+	// Largest distance of a point from the iso level, the quantized values are fractions of it
+	float Range = 0.0f;
+
+	std::vector<float> LayerValues;
+	std::vector<float> Values32;
+	std::vector<int16_t> Values16;
+	std::vector<int8_t> Values8;
+};
+
+}
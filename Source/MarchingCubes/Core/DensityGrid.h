@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace MarchingCore
+{
+
+// Cubic grid of density samples, indexed x + N * (y + N * z)
+class DensityGrid
+{
+public:
+	explicit DensityGrid(int InPointsPerAxis)
+		: PointsPerAxis(InPointsPerAxis)
+		, Values(static_cast<size_t>(InPointsPerAxis) * InPointsPerAxis * InPointsPerAxis, 0.0f)
+	{
+	}
+
+	int GetPointsPerAxis() const { return PointsPerAxis; }
+	int Index(int X, int Y, int Z) const { return X + PointsPerAxis * (Y + PointsPerAxis * Z); }
+
+	float& At(int X, int Y, int Z) { return Values[Index(X, Y, Z)]; }
+	float At(int X, int Y, int Z) const { return Values[Index(X, Y, Z)]; }
+
+	float* GetData() { return Values.data(); }
+	const float* GetData() const { return Values.data(); }
+
+private:
+	int PointsPerAxis;
+	std::vector<float> Values;
+};
+
+}
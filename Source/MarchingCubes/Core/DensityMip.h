@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+
+namespace MarchingCore
+{
+
+// Coarser level of a density grid for marching distant chunks, every Stride-th point of each axis.
+// The chunk's cells rarely divide by the stride, so the last mip point always samples the last grid point and the last
+// mip cell is shorter. Border points are sampled at the same places on both sides of a chunk border.
+struct DensityMip
+{
+	static int GetPointsPerAxis(int PointsPerAxis, int Stride)
+	{
+		return Stride <= 1 ? PointsPerAxis : (PointsPerAxis - 2) / Stride + 2;
+	}
+
+	// Full resolution grid point a mip point samples
+	static int GetSourcePoint(int MipPoint, int PointsPerAxis, int Stride)
+	{
+		const int Point = MipPoint * Stride;
+		return Point < PointsPerAxis - 1 ? Point : PointsPerAxis - 1;
+	}
+
+	// Fills the GetPointsPerAxis^3 mip of Density, indexed like the source grid
+	static void Downsample(const float* Density, int PointsPerAxis, int Stride, float* OutMip)
+	{
+		const int MipPoints = GetPointsPerAxis(PointsPerAxis, Stride);
+		for (int z = 0; z < MipPoints; z++)
+		{
+			const int SourceZ = GetSourcePoint(z, PointsPerAxis, Stride);
+			for (int y = 0; y < MipPoints; y++)
+			{
+				const int SourceY = GetSourcePoint(y, PointsPerAxis, Stride);
+				const float* SourceRow = Density + static_cast<size_t>(PointsPerAxis) * (SourceY + static_cast<size_t>(PointsPerAxis) * SourceZ);
+				float* MipRow = OutMip + static_cast<size_t>(MipPoints) * (y + static_cast<size_t>(MipPoints) * z);
+				for (int x = 0; x < MipPoints; x++)
+				{
+					MipRow[x] = SourceRow[GetSourcePoint(x, PointsPerAxis, Stride)];
+				}
+			}
+		}
+	}
+
+	// Maps a coordinate of a mesh marched on the mip back to full resolution grid units.
+	// Vertices lie on cell edges, so mapping every axis piecewise linearly keeps them on the same edges.
+	static float ToSourceCoordinate(float MipCoordinate, int PointsPerAxis, int Stride)
+	{
+		const int LastCell = GetPointsPerAxis(PointsPerAxis, Stride) - 2;
+		if (MipCoordinate <= LastCell)
+		{
+			return MipCoordinate * Stride;
+		}
+		const float LastCellSize = static_cast<float>(PointsPerAxis - 1 - LastCell * Stride);
+		return LastCell * Stride + (MipCoordinate - LastCell) * LastCellSize;
+	}
+
+	template<typename VectorType>
+	static void ToSourcePositions(VectorType* Verts, int NumVerts, int PointsPerAxis, int Stride)
+	{
+		for (int i = 0; i < NumVerts; i++)
+		{
+			VectorType& Vert = Verts[i];
+			Vert = VectorType(ToSourceCoordinate(Vert.X, PointsPerAxis, Stride), ToSourceCoordinate(Vert.Y, PointsPerAxis, Stride),
+				ToSourceCoordinate(Vert.Z, PointsPerAxis, Stride));
+		}
+	}
+};
+
+}
@@ -0,0 +1,124 @@
+#include "EditJournal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace MarchingCore
+{
+
+namespace
+{
+	// FNV-1a, enough to tell a torn record from a whole one
+	uint32_t GetChecksum(const uint8_t* Data, size_t Size)
+	{
+		uint32_t Hash = 2166136261u;
+		for (size_t i = 0; i < Size; i++)
+		{
+			Hash = (Hash ^ Data[i]) * 16777619u;
+		}
+		return Hash;
+	}
+
+	void AppendBytes(std::vector<uint8_t>& Out, const void* Data, size_t Size)
+	{
+		const size_t Offset = Out.size();
+		Out.resize(Offset + Size);
+		std::memcpy(Out.data() + Offset, Data, Size);
+	}
+}
+
+bool GetBrushBox(const BrushEdit& Edit, int ChunkX, int ChunkY, int ChunkZ, int PointsPerChunk, int OutMin[3], int OutMax[3])
+{
+	const int Span = PointsPerChunk - 1;
+	const int Offset[3] = { (ChunkX - Edit.ChunkX) * Span, (ChunkY - Edit.ChunkY) * Span, (ChunkZ - Edit.ChunkZ) * Span };
+	const float Center[3] = { Edit.CenterX, Edit.CenterY, Edit.CenterZ };
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		OutMin[Axis] = std::max(static_cast<int>(std::floor(Center[Axis] - Edit.Radius)) - Offset[Axis], 0);
+		OutMax[Axis] = std::min(static_cast<int>(std::ceil(Center[Axis] + Edit.Radius)) - Offset[Axis], PointsPerChunk - 1);
+		if (OutMin[Axis] > OutMax[Axis])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void ApplyBrushEdit(const BrushEdit& Edit, int ChunkX, int ChunkY, int ChunkZ, int PointsPerChunk, float* Density, const int Min[3], const int Max[3])
+{
+	const int Span = PointsPerChunk - 1;
+	const int OffsetX = (ChunkX - Edit.ChunkX) * Span;
+	const int OffsetY = (ChunkY - Edit.ChunkY) * Span;
+	const int OffsetZ = (ChunkZ - Edit.ChunkZ) * Span;
+	const float RadiusSq = Edit.Radius * Edit.Radius;
+	const float RadiusSqInverse = 1.0f / RadiusSq;
+
+	for (int z = Min[2]; z <= Max[2]; z++)
+	{
+		// Distances are taken in the grid of the edit's chunk, so every chunk sharing a point computes the same value
+		const float DZ = static_cast<float>(z + OffsetZ) - Edit.CenterZ;
+		for (int y = Min[1]; y <= Max[1]; y++)
+		{
+			const float DY = static_cast<float>(y + OffsetY) - Edit.CenterY;
+			float* Row = Density + PointsPerChunk * (y + PointsPerChunk * z);
+			for (int x = Min[0]; x <= Max[0]; x++)
+			{
+				const float DX = static_cast<float>(x + OffsetX) - Edit.CenterX;
+				const float DistSq = DX * DX + DY * DY + DZ * DZ;
+				if (DistSq < RadiusSq)
+				{
+					const float Influence = std::clamp(1.0f - DistSq * RadiusSqInverse, 0.0f, 1.0f);
+					Row[x] += Edit.Strength * Influence;
+				}
+			}
+		}
+	}
+}
+
+namespace EditJournal
+{
+
+void AppendHeader(std::vector<uint8_t>& Out, const Header& InHeader)
+{
+	AppendBytes(Out, &InHeader, sizeof(InHeader));
+}
+
+void AppendRecord(std::vector<uint8_t>& Out, const BrushEdit& Edit)
+{
+	const uint32_t Checksum = GetChecksum(reinterpret_cast<const uint8_t*>(&Edit), sizeof(Edit));
+	AppendBytes(Out, &Edit, sizeof(Edit));
+	AppendBytes(Out, &Checksum, sizeof(Checksum));
+}
+
+bool Read(const uint8_t* Data, size_t Size, Header& OutHeader, std::vector<BrushEdit>& OutEdits)
+{
+	OutEdits.clear();
+	if (Size < sizeof(Header))
+	{
+		return false;
+	}
+	std::memcpy(&OutHeader, Data, sizeof(Header));
+	if (OutHeader.Magic != Magic || OutHeader.Version != Version)
+	{
+		return false;
+	}
+
+	for (size_t Offset = sizeof(Header); Offset + RecordSize <= Size; Offset += RecordSize)
+	{
+		uint32_t Checksum;
+		std::memcpy(&Checksum, Data + Offset + sizeof(BrushEdit), sizeof(Checksum));
+		if (Checksum != GetChecksum(Data + Offset, sizeof(BrushEdit)))
+		{
+			break;
+		}
+		BrushEdit Edit;
+		std::memcpy(&Edit, Data + Offset, sizeof(Edit));
+		OutEdits.push_back(Edit);
+	}
+	return true;
+}
+
+}
+
+}
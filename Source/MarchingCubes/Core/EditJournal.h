@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MarchingCore
+{
+
+// One terraform brush stroke. Its center is in the grid of the chunk it was aimed at, it is applied to every chunk it
+// reaches and evaluated in that same grid for each of them, so points shared by neighbouring chunks get identical values.
+struct BrushEdit
+{
+	// Position in the journal, 0 for an edit that was never recorded
+	uint32_t Sequence = 0;
+	int32_t ChunkX = 0;
+	int32_t ChunkY = 0;
+	int32_t ChunkZ = 0;
+	float CenterX = 0.0f;
+	float CenterY = 0.0f;
+	float CenterZ = 0.0f;
+	float Radius = 0.0f;
+	// Added to the density at the center and fading out towards the radius, negative to dig
+	float Strength = 0.0f;
+};
+
+// Box of grid points of the chunk at ChunkX/Y/Z the edit reaches, false when it reaches none of them
+bool GetBrushBox(const BrushEdit& Edit, int ChunkX, int ChunkY, int ChunkZ, int PointsPerChunk, int OutMin[3], int OutMax[3]);
+
+// Adds the edit to the PointsPerChunk^3 density of the chunk at ChunkX/Y/Z inside the box from GetBrushBox
+void ApplyBrushEdit(const BrushEdit& Edit, int ChunkX, int ChunkY, int ChunkZ, int PointsPerChunk, float* Density, const int Min[3], const int Max[3]);
+
+// Calls Func(ChunkX, ChunkY, ChunkZ, Min, Max) for every chunk the edit reaches
+template<typename FuncType>
+void ForEachBrushChunk(const BrushEdit& Edit, int PointsPerChunk, FuncType&& Func)
+{
+	// A chunk spans PointsPerChunk - 1 points, a brush reaches at most this many chunks past its own in every direction
+	const int Reach = static_cast<int>(Edit.Radius) / (PointsPerChunk - 1) + 1;
+	for (int z = -Reach; z <= Reach; z++)
+	{
+		for (int y = -Reach; y <= Reach; y++)
+		{
+			for (int x = -Reach; x <= Reach; x++)
+			{
+				int Min[3];
+				int Max[3];
+				if (GetBrushBox(Edit, Edit.ChunkX + x, Edit.ChunkY + y, Edit.ChunkZ + z, PointsPerChunk, Min, Max))
+				{
+					Func(Edit.ChunkX + x, Edit.ChunkY + y, Edit.ChunkZ + z, Min, Max);
+				}
+			}
+		}
+	}
+}
+
+// File layout of the edit journal: a header followed by fixed size records, each a BrushEdit and its checksum.
+// Records are only ever appended, a record cut short or damaged by a crash ends the journal.
+namespace EditJournal
+{
+	constexpr uint32_t Magic = 0x4A45434D; // "MCEJ"
+	constexpr uint32_t Version = 1;
+
+	struct Header
+	{
+		uint32_t Magic = EditJournal::Magic;
+		uint32_t Version = EditJournal::Version;
+		// Sequence the next edit gets, kept when the journal is emptied so sequences keep growing across compactions
+		uint32_t NextSequence = 1;
+		uint32_t Reserved = 0;
+	};
+
+	constexpr size_t RecordSize = sizeof(BrushEdit) + sizeof(uint32_t);
+
+	void AppendHeader(std::vector<uint8_t>& Out, const Header& InHeader);
+	void AppendRecord(std::vector<uint8_t>& Out, const BrushEdit& Edit);
+
+	// Reads the header and every intact record up to the first torn or damaged one, false when Data is no journal
+	bool Read(const uint8_t* Data, size_t Size, Header& OutHeader, std::vector<BrushEdit>& OutEdits);
+}
+
+}
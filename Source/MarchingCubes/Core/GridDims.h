@@ -0,0 +1,38 @@
+#pragma once
+
+namespace MarchingCore
+{
+
+// Grid size known at compile time, so index maths, loop bounds and buffer sizes fold into constants the compiler can
+// unroll and vectorise
+template<int InPointsPerAxis>
+struct StaticGrid
+{
+	static constexpr int PointsPerAxis = InPointsPerAxis;
+	static constexpr int NumPoints = InPointsPerAxis * InPointsPerAxis * InPointsPerAxis;
+
+	static constexpr int Index(int X, int Y, int Z) { return X + PointsPerAxis * (Y + PointsPerAxis * Z); }
+};
+
+// Same interface for sizes without an instantiation
+struct DynamicGrid
+{
+	int PointsPerAxis;
+
+	int Index(int X, int Y, int Z) const { return X + PointsPerAxis * (Y + PointsPerAxis * Z); }
+};
+
+// Calls Body with the StaticGrid matching PointsPerAxis, or with a DynamicGrid for any other size
+template<typename FunctionType>
+void DispatchGrid(int PointsPerAxis, FunctionType&& Body)
+{
+	switch (PointsPerAxis)
+	{
+	case 16: Body(StaticGrid<16>()); break;
+	case 32: Body(StaticGrid<32>()); break;
+	case 64: Body(StaticGrid<64>()); break;
+	default: Body(DynamicGrid{ PointsPerAxis }); break;
+	}
+}
+
+}
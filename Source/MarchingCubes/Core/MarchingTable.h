@@ -1,23 +1,37 @@
 #pragma once
 
-static const int EdgeConnections[12][2] = {
+#include <cstdint>
+
+namespace MarchingCore
+{
+
+static constexpr int EdgeConnections[12][2] = {
 	{0,1}, {1,2}, {2,3}, {3,0},
 	{4,5}, {5,6}, {6,7}, {7,4},
 	{0,4}, {1,5}, {2,6}, {3,7}
 };
 
-static const FVector CornerOffsets[8] = {
-	FVector(0, 0, 1),
-	FVector(1, 0, 1),
-	FVector(1, 0, 0),
-	FVector(0, 0, 0),
-	FVector(0, 1, 1),
-	FVector(1, 1, 1),
-	FVector(1, 1, 0),
-	FVector(0, 1, 0)
+// For every edge: the offset of the grid point that owns it (relative to the cube origin) and the axis it runs along (0 = X, 1 = Y, 2 = Z).
+// Each grid point owns the three edges leaving it in positive direction, so neighbouring cubes resolve a shared edge to the same key.
+static constexpr int EdgeOwners[12][4] = {
+	{0,0,1,0}, {1,0,0,2}, {0,0,0,0}, {0,0,0,2},
+	{0,1,1,0}, {1,1,0,2}, {0,1,0,0}, {0,1,0,2},
+	{0,0,1,1}, {1,0,1,1}, {1,0,0,1}, {0,0,0,1}
 };
 
-static const int TriTable[256][16] =
+// Position of every cube corner relative to the cube origin
+static constexpr int CornerOffsets[8][3] = {
+	{0, 0, 1},
+	{1, 0, 1},
+	{1, 0, 0},
+	{0, 0, 0},
+	{0, 1, 1},
+	{1, 1, 1},
+	{1, 1, 0},
+	{0, 1, 0}
+};
+
+static constexpr int TriTable[256][16] =
 { {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 {0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 {0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
@@ -273,4 +287,49 @@ static const int TriTable[256][16] =
 {1, 3, 8, 9, 1, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 {0, 9, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 {0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-{-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1} };
\ No newline at end of file
+{-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1} };
+
+// Per case counts derived from TriTable, used to size the mesh buffers exactly before anything is emitted
+struct CaseCountTable
+{
+	// Number of triangles every cube configuration produces
+	uint8_t Triangles[256];
+	// Number of crossed edges a cube is responsible for, indexed by the axes along which it is the last cube of its
+	// range (bit 0 = X, 1 = Y, 2 = Z). A cube counts the edges its origin point owns, plus the ones on its far faces
+	// when no further cube shares them, so every crossed edge of the range is counted exactly once.
+	uint8_t Edges[8][256];
+};
+
+constexpr CaseCountTable BuildCaseCounts()
+{
+	CaseCountTable Counts{};
+	for (int Case = 0; Case < 256; Case++)
+	{
+		int NumIndices = 0;
+		while (NumIndices < 16 && TriTable[Case][NumIndices] != -1)
+		{
+			NumIndices++;
+		}
+		Counts.Triangles[Case] = static_cast<uint8_t>(NumIndices / 3);
+
+		for (int LastAxes = 0; LastAxes < 8; LastAxes++)
+		{
+			int NumEdges = 0;
+			for (int Edge = 0; Edge < 12; Edge++)
+			{
+				const bool bCrossed = ((Case >> EdgeConnections[Edge][0]) & 1) != ((Case >> EdgeConnections[Edge][1]) & 1);
+				const int OwnerAxes = EdgeOwners[Edge][0] | (EdgeOwners[Edge][1] << 1) | (EdgeOwners[Edge][2] << 2);
+				if (bCrossed && (OwnerAxes & ~LastAxes) == 0)
+				{
+					NumEdges++;
+				}
+			}
+			Counts.Edges[LastAxes][Case] = static_cast<uint8_t>(NumEdges);
+		}
+	}
+	return Counts;
+}
+
+static constexpr CaseCountTable CaseCounts = BuildCaseCounts();
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+// Plain value types of the marching core, kept free of engine types so the core builds on its own.
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace MarchingCore
+{
+
+struct Vec3
+{
+	float X = 0.0f;
+	float Y = 0.0f;
+	float Z = 0.0f;
+
+	Vec3() = default;
+	Vec3(float InX, float InY, float InZ) : X(InX), Y(InY), Z(InZ) {}
+
+	Vec3 operator+(const Vec3& Other) const { return Vec3(X + Other.X, Y + Other.Y, Z + Other.Z); }
+	Vec3 operator-(const Vec3& Other) const { return Vec3(X - Other.X, Y - Other.Y, Z - Other.Z); }
+	Vec3 operator*(float Scale) const { return Vec3(X * Scale, Y * Scale, Z * Scale); }
+};
+
+// Unit vector in 32 bits: X, Y and Z as signed normalized 10 bit integers, the top 2 bits unused.
+// Constructible from (X, Y, Z) like any other vector type, so the mesher can write normals straight into it.
+struct PackedNormal
+{
+	uint32_t Bits = 0;
+
+	PackedNormal() = default;
+	PackedNormal(float InX, float InY, float InZ)
+		: Bits(PackComponent(InX) | (PackComponent(InY) << 10) | (PackComponent(InZ) << 20))
+	{
+	}
+
+	Vec3 Unpack() const { return Vec3(UnpackComponent(Bits), UnpackComponent(Bits >> 10), UnpackComponent(Bits >> 20)); }
+
+private:
+	static uint32_t PackComponent(float Value)
+	{
+		const float Clamped = Value < -1.0f ? -1.0f : (Value > 1.0f ? 1.0f : Value);
+		const int32_t Quantized = static_cast<int32_t>(Clamped * 511.0f + (Clamped < 0.0f ? -0.5f : 0.5f));
+		return static_cast<uint32_t>(Quantized) & 0x3FF;
+	}
+
+	static float UnpackComponent(uint32_t Field)
+	{
+		// Sign extend the 10 bit field, -512 and -511 both decode to -1
+		const int32_t Quantized = static_cast<int32_t>(Field << 22) >> 22;
+		const float Value = static_cast<float>(Quantized) * (1.0f / 511.0f);
+		return Value < -1.0f ? -1.0f : Value;
+	}
+};
+
+// Min/max of a set of densities, empty until the first value is included
+struct DensityRange
+{
+	float Min = std::numeric_limits<float>::infinity();
+	float Max = -std::numeric_limits<float>::infinity();
+
+	void Include(float Value)
+	{
+		Min = Value < Min ? Value : Min;
+		Max = Value > Max ? Value : Max;
+	}
+
+	void Include(const DensityRange& Other)
+	{
+		Min = Other.Min < Min ? Other.Min : Min;
+		Max = Other.Max > Max ? Other.Max : Max;
+	}
+
+	// A cube produces triangles only when some corners are below and some are at or above the iso level
+	bool Crosses(float IsoLevel) const { return Min < IsoLevel && Max >= IsoLevel; }
+};
+
+}
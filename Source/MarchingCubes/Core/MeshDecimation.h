@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace MarchingCore
+{
+
+// Vertex clustering decimation: the vertices in every cell of CellSize grid units collapse into their average, and
+// triangles left with fewer than three distinct corners are dropped. Coarse but cheap and watertight enough for collision.
+// Works on any vector type with X/Y/Z members and an (X, Y, Z) constructor. OutVerts must hold NumVerts and OutTris
+// NumIndices elements. Returns the number of vertices written, OutNumIndices receives the number of indices.
+template<typename VectorType>
+int32_t DecimateByClustering(const VectorType* Verts, int32_t NumVerts, const int32_t* Tris, int32_t NumIndices, float CellSize,
+	VectorType* OutVerts, int32_t* OutTris, int32_t& OutNumIndices)
+{
+	using ScalarType = std::decay_t<decltype(Verts[0].X)>;
+
+	// 21 bits per axis cover any chunk or region with room to spare
+	const auto CellKey = [CellSize](ScalarType X, ScalarType Y, ScalarType Z)
+	{
+		const int64_t CellX = static_cast<int64_t>(std::floor(X / CellSize)) & 0x1FFFFF;
+		const int64_t CellY = static_cast<int64_t>(std::floor(Y / CellSize)) & 0x1FFFFF;
+		const int64_t CellZ = static_cast<int64_t>(std::floor(Z / CellSize)) & 0x1FFFFF;
+		return CellX | (CellY << 21) | (CellZ << 42);
+	};
+
+	std::unordered_map<int64_t, int32_t> Clusters;
+	Clusters.reserve(static_cast<size_t>(NumVerts));
+	std::vector<int32_t> Remap(static_cast<size_t>(NumVerts));
+	std::vector<int32_t> Counts;
+	int32_t NumClusters = 0;
+	for (int32_t i = 0; i < NumVerts; i++)
+	{
+		const VectorType& Vert = Verts[i];
+		const auto Inserted = Clusters.emplace(CellKey(Vert.X, Vert.Y, Vert.Z), NumClusters);
+		if (Inserted.second)
+		{
+			OutVerts[NumClusters] = VectorType(0, 0, 0);
+			Counts.push_back(0);
+			NumClusters++;
+		}
+
+		const int32_t Cluster = Inserted.first->second;
+		OutVerts[Cluster].X += Vert.X;
+		OutVerts[Cluster].Y += Vert.Y;
+		OutVerts[Cluster].Z += Vert.Z;
+		Counts[Cluster]++;
+		Remap[i] = Cluster;
+	}
+
+	for (int32_t i = 0; i < NumClusters; i++)
+	{
+		const ScalarType Scale = ScalarType(1) / static_cast<ScalarType>(Counts[i]);
+		const VectorType& Sum = OutVerts[i];
+		OutVerts[i] = VectorType(Sum.X * Scale, Sum.Y * Scale, Sum.Z * Scale);
+	}
+
+	OutNumIndices = 0;
+	for (int32_t i = 0; i + 2 < NumIndices; i += 3)
+	{
+		const int32_t A = Remap[Tris[i]];
+		const int32_t B = Remap[Tris[i + 1]];
+		const int32_t C = Remap[Tris[i + 2]];
+		if (A == B || B == C || A == C)
+		{
+			continue;
+		}
+		OutTris[OutNumIndices++] = A;
+		OutTris[OutNumIndices++] = B;
+		OutTris[OutNumIndices++] = C;
+	}
+	return NumClusters;
+}
+
+}
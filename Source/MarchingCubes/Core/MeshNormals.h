@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+
+namespace MarchingCore
+{
+
+// Smooth vertex normals as the normalized sum of the normals of the faces around each vertex.
+// Works on any vector type with X/Y/Z members and an (X, Y, Z) constructor.
+// Indices are in the reversed winding the mesher emits.
+template<typename VectorType>
+void CalcAverageNormals(const VectorType* Verts, int32_t NumVerts, const int32_t* Tris, int32_t NumIndices, VectorType* OutNormals)
+{
+	using ScalarType = std::decay_t<decltype(Verts[0].X)>;
+	constexpr ScalarType SmallNumber = ScalarType(1.e-8);
+
+	for (int32_t i = 0; i < NumVerts; i++)
+	{
+		OutNormals[i] = VectorType(0, 0, 0);
+	}
+
+	// Iterates through each triangle in the mesh
+	for (int32_t i = 0; i + 2 < NumIndices; i += 3)
+	{
+		const int32_t i0 = Tris[i + 2];
+		const int32_t i1 = Tris[i + 1];
+		const int32_t i2 = Tris[i];
+
+		const ScalarType v1X = Verts[i1].X - Verts[i0].X, v1Y = Verts[i1].Y - Verts[i0].Y, v1Z = Verts[i1].Z - Verts[i0].Z;
+		const ScalarType v2X = Verts[i2].X - Verts[i0].X, v2Y = Verts[i2].Y - Verts[i0].Y, v2Z = Verts[i2].Z - Verts[i0].Z;
+
+		ScalarType NX = v1Y * v2Z - v1Z * v2Y;
+		ScalarType NY = v1Z * v2X - v1X * v2Z;
+		ScalarType NZ = v1X * v2Y - v1Y * v2X;
+
+		// Degenerate triangles contribute nothing
+		const ScalarType SquareSum = NX * NX + NY * NY + NZ * NZ;
+		if (SquareSum <= SmallNumber)
+		{
+			continue;
+		}
+		const ScalarType Scale = ScalarType(1) / std::sqrt(SquareSum);
+		NX *= Scale;
+		NY *= Scale;
+		NZ *= Scale;
+
+		// Accumulate the face normal to the corresponding vertices.
+		for (int32_t Vertex : {i0, i1, i2})
+		{
+			OutNormals[Vertex].X += NX;
+			OutNormals[Vertex].Y += NY;
+			OutNormals[Vertex].Z += NZ;
+		}
+	}
+
+	// Normalize the accumulated normals for each vertex to get the average normals.
+	for (int32_t i = 0; i < NumVerts; i++)
+	{
+		VectorType& Normal = OutNormals[i];
+		const ScalarType SquareSum = Normal.X * Normal.X + Normal.Y * Normal.Y + Normal.Z * Normal.Z;
+		if (SquareSum > SmallNumber)
+		{
+			const ScalarType Scale = ScalarType(1) / std::sqrt(SquareSum);
+			Normal = VectorType(Normal.X * Scale, Normal.Y * Scale, Normal.Z * Scale);
+		}
+	}
+}
+
+}
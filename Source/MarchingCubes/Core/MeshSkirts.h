@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+
+namespace MarchingCore
+{
+
+// Skirts hide the cracks between chunks meshed at different strides, standing in for Transvoxel transition cells: they
+// need no extra density samples and no case tables of their own, at the price of a vertical seam instead of a stitched
+// surface. Every triangle edge lying on one of the chosen side faces of the chunk (X or Y at 0 or Extent) is a border
+// of the mesh, and gets a quad hanging Depth grid units down in the face plane. The quads continue the winding of their
+// triangle, so they face the same way as the surface they extend.
+// Only the side faces get skirts. The spawner picks strides from the horizontal distance alone, so chunks stacked in a
+// column always share their stride and never crack against each other.
+namespace MeshSkirts
+{
+	// Bit of the side face on the Positive or negative side of Axis (0 = X, 1 = Y), the same layout as
+	// TerrainDensity::GetBorderBit
+	constexpr uint8_t GetFaceBit(int Axis, bool bPositive) { return static_cast<uint8_t>(1u << (Axis * 2 + (bPositive ? 1 : 0))); }
+	constexpr uint8_t AllFaces = 0xF;
+
+	// Side faces a position lies on, one bit per face
+	template<typename VectorType>
+	int GetSideFaces(const VectorType& Vert, float Extent)
+	{
+		return (Vert.X <= 0.0f) | ((Vert.X >= Extent) << 1) | ((Vert.Y <= 0.0f) << 2) | ((Vert.Y >= Extent) << 3);
+	}
+
+	template<typename VectorType>
+	bool IsSkirtEdge(const VectorType& A, const VectorType& B, float Extent, uint8_t Faces)
+	{
+		return (GetSideFaces(A, Extent) & GetSideFaces(B, Extent) & Faces) != 0;
+	}
+
+	// Number of border edges on Faces, every one adds 2 vertices and 6 indices
+	template<typename VectorType>
+	int32_t CountEdges(const VectorType* Verts, const int32_t* Tris, int32_t NumIndices, float Extent, uint8_t Faces)
+	{
+		int32_t NumEdges = 0;
+		for (int32_t i = 0; i + 2 < NumIndices; i += 3)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				NumEdges += IsSkirtEdge(Verts[Tris[i + j]], Verts[Tris[i + (j + 1) % 3]], Extent, Faces);
+			}
+		}
+		return NumEdges;
+	}
+
+	// Appends the skirts of Faces after the NumVerts vertices and NumIndices indices of the mesh, the buffers must have
+	// room for CountEdges more. The lower skirt vertices copy the normal of the vertex above them, OutNormals may be null.
+	template<typename VectorType, typename NormalType>
+	void Append(VectorType* Verts, NormalType* Normals, int32_t NumVerts, int32_t* Tris, int32_t NumIndices, float Extent, float Depth, uint8_t Faces)
+	{
+		int32_t NextVertex = NumVerts;
+		int32_t NextIndex = NumIndices;
+		for (int32_t i = 0; i + 2 < NumIndices; i += 3)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				const int32_t From = Tris[i + j];
+				const int32_t To = Tris[i + (j + 1) % 3];
+				if (!IsSkirtEdge(Verts[From], Verts[To], Extent, Faces))
+				{
+					continue;
+				}
+
+				const int32_t FromBelow = NextVertex++;
+				const int32_t ToBelow = NextVertex++;
+				Verts[FromBelow] = VectorType(Verts[From].X, Verts[From].Y, Verts[From].Z - Depth);
+				Verts[ToBelow] = VectorType(Verts[To].X, Verts[To].Y, Verts[To].Z - Depth);
+				if (Normals)
+				{
+					Normals[FromBelow] = Normals[From];
+					Normals[ToBelow] = Normals[To];
+				}
+
+				// The neighbouring triangle across From -> To would run To -> From
+				Tris[NextIndex++] = To;
+				Tris[NextIndex++] = From;
+				Tris[NextIndex++] = FromBelow;
+				Tris[NextIndex++] = To;
+				Tris[NextIndex++] = FromBelow;
+				Tris[NextIndex++] = ToBelow;
+			}
+		}
+	}
+}
+
+}
@@ -0,0 +1,764 @@
+#include "Mesher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "GridDims.h"
+#include "MarchingTable.h"
+
+namespace MarchingCore
+{
+
+namespace
+{
+	template<typename GridType>
+	DensityRange SummarizeBrick(const GridType Grid, const float* Density, int BrickX, int BrickY, int BrickZ)
+	{
+		constexpr int BrickSize = Mesher::BrickSize;
+
+		// A brick's cubes read the points up to and including the first point of the next brick
+		DensityRange BrickRange;
+		const int EndZ = std::min((BrickZ + 1) * BrickSize, Grid.PointsPerAxis - 1);
+		const int EndY = std::min((BrickY + 1) * BrickSize, Grid.PointsPerAxis - 1);
+		const int EndX = std::min((BrickX + 1) * BrickSize, Grid.PointsPerAxis - 1);
+		for (int z = BrickZ * BrickSize; z <= EndZ; z++)
+		{
+			for (int y = BrickY * BrickSize; y <= EndY; y++)
+			{
+				const float* Row = Density + Grid.Index(0, y, z);
+				for (int x = BrickX * BrickSize; x <= EndX; x++)
+				{
+					BrickRange.Include(Row[x]);
+				}
+			}
+		}
+		return BrickRange;
+	}
+
+	template<typename GridType>
+	int GetCubeIndex(const GridType Grid, const float* Density, int X, int Y, int Z, float IsoLevel, float (&CubeValues)[8])
+	{
+		// Get the density values at the corners of our cube
+		const int Base = Grid.Index(X, Y, Z);
+		const int StepY = Grid.Index(0, 1, 0);
+		const int StepZ = Grid.Index(0, 0, 1);
+		CubeValues[0] = Density[Base + StepZ];
+		CubeValues[1] = Density[Base + 1 + StepZ];
+		CubeValues[2] = Density[Base + 1];
+		CubeValues[3] = Density[Base];
+		CubeValues[4] = Density[Base + StepY + StepZ];
+		CubeValues[5] = Density[Base + 1 + StepY + StepZ];
+		CubeValues[6] = Density[Base + 1 + StepY];
+		CubeValues[7] = Density[Base + StepY];
+
+		// Get the cube configuration
+		int CubeIndex = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			if (CubeValues[i] < IsoLevel) CubeIndex |= 1 << i;
+		}
+		return CubeIndex;
+	}
+
+	// Position of the iso crossing along an edge, as a fraction of the way from corner 0 to corner 1
+	float GetCrossing(float Value0, float Value1, float IsoLevel)
+	{
+		return (IsoLevel - Value0) / (Value1 - Value0);
+	}
+
+	Vec3 InterpolateVertex(int Corner0, int Corner1, float Crossing)
+	{
+		const Vec3 P0(CornerOffsets[Corner0][0], CornerOffsets[Corner0][1], CornerOffsets[Corner0][2]);
+		const Vec3 P1(CornerOffsets[Corner1][0], CornerOffsets[Corner1][1], CornerOffsets[Corner1][2]);
+		return P0 + (P1 - P0) * Crossing;
+	}
+
+	// Central difference gradient of the density at a grid point, one sided on the chunk border
+	template<typename GridType>
+	Vec3 GetDensityGradient(const GridType Grid, const float* Density, int X, int Y, int Z)
+	{
+		const int Last = Grid.PointsPerAxis - 1;
+		const int X0 = std::max(X - 1, 0), X1 = std::min(X + 1, Last);
+		const int Y0 = std::max(Y - 1, 0), Y1 = std::min(Y + 1, Last);
+		const int Z0 = std::max(Z - 1, 0), Z1 = std::min(Z + 1, Last);
+		return Vec3(
+			(Density[Grid.Index(X1, Y, Z)] - Density[Grid.Index(X0, Y, Z)]) / static_cast<float>(X1 - X0),
+			(Density[Grid.Index(X, Y1, Z)] - Density[Grid.Index(X, Y0, Z)]) / static_cast<float>(Y1 - Y0),
+			(Density[Grid.Index(X, Y, Z1)] - Density[Grid.Index(X, Y, Z0)]) / static_cast<float>(Z1 - Z0));
+	}
+
+	// Surface normal at an edge crossing, the gradients of both corners blended like the position.
+	// The density falls towards the air, so the normal points down the gradient.
+	Vec3 BlendGradients(const Vec3& G0, const Vec3& G1, float Crossing)
+	{
+		const Vec3 Gradient = G0 + (G1 - G0) * Crossing;
+		const float SquareSum = Gradient.X * Gradient.X + Gradient.Y * Gradient.Y + Gradient.Z * Gradient.Z;
+		if (SquareSum <= 1.e-8f)
+		{
+			return Vec3(0.0f, 0.0f, 1.0f);
+		}
+		return Gradient * (-1.0f / std::sqrt(SquareSum));
+	}
+
+	template<typename GridType>
+	Vec3 InterpolateNormal(const GridType Grid, const float* Density, int X, int Y, int Z, int Corner0, int Corner1, float Crossing)
+	{
+		const Vec3 G0 = GetDensityGradient(Grid, Density,
+			X + CornerOffsets[Corner0][0], Y + CornerOffsets[Corner0][1], Z + CornerOffsets[Corner0][2]);
+		const Vec3 G1 = GetDensityGradient(Grid, Density,
+			X + CornerOffsets[Corner1][0], Y + CornerOffsets[Corner1][1], Z + CornerOffsets[Corner1][2]);
+		return BlendGradients(G0, G1, Crossing);
+	}
+
+	// Marches the cubes of one brick in two passes, Origin is the first point of the brick.
+	// The first pass classifies every cube and counts its triangles and vertices from the case tables, the second one
+	// emits straight into buffers of exactly that size.
+	template<typename GridType>
+	void MarchBrickCubes(const GridType Grid, const float* Density, float IsoLevel, bool bShareVertices, bool bGradientNormals,
+		const int (&Origin)[3], MeshBrick& Brick, MarchScratch& Scratch)
+	{
+		constexpr int BrickSize = Mesher::BrickSize;
+		constexpr int CachePoints = BrickSize + 1;
+
+		const int LastCell = Grid.PointsPerAxis - 2;
+		const int EndZ = std::min(Origin[2] + BrickSize, LastCell + 1);
+		const int EndY = std::min(Origin[1] + BrickSize, LastCell + 1);
+		const int EndX = std::min(Origin[0] + BrickSize, LastCell + 1);
+
+		Scratch.CubeCases.resize(BrickSize * BrickSize * BrickSize);
+		uint8_t* Cases = Scratch.CubeCases.data();
+
+		int32_t NumTriangles = 0;
+		int32_t NumVerts = 0;
+		int32_t NumOwnedVerts = 0;
+		for (int z = Origin[2]; z < EndZ; z++)
+		{
+			for (int y = Origin[1]; y < EndY; y++)
+			{
+				for (int x = Origin[0]; x < EndX; x++)
+				{
+					float CubeValues[8];
+					const int Case = GetCubeIndex(Grid, Density, x, y, z, IsoLevel, CubeValues);
+					Cases[(x - Origin[0]) + BrickSize * ((y - Origin[1]) + BrickSize * (z - Origin[2]))] = static_cast<uint8_t>(Case);
+					NumTriangles += CaseCounts.Triangles[Case];
+
+					// Edges on the far faces of the brick are counted by its last cubes, but only owned when the chunk ends there
+					const int LastInBrick = (x == EndX - 1) | ((y == EndY - 1) << 1) | ((z == EndZ - 1) << 2);
+					const int LastInChunk = (x == LastCell) | ((y == LastCell) << 1) | ((z == LastCell) << 2);
+					NumVerts += CaseCounts.Edges[LastInBrick][Case];
+					NumOwnedVerts += CaseCounts.Edges[LastInChunk][Case];
+				}
+			}
+		}
+		if (NumTriangles == 0)
+		{
+			return;
+		}
+		if (!bShareVertices)
+		{
+			NumVerts = NumTriangles * 3;
+			NumOwnedVerts = NumVerts;
+		}
+
+		Brick.Verts.resize(NumVerts);
+		Brick.EdgeKeys.resize(NumVerts);
+		Brick.Tris.resize(NumTriangles * 3);
+		Brick.Normals.resize(bGradientNormals ? NumVerts : 0);
+		Brick.NumOwnedVerts = NumOwnedVerts;
+		if (bShareVertices)
+		{
+			Scratch.EdgeCache.assign(CachePoints * CachePoints * CachePoints * 3, -1);
+		}
+
+		Vec3* OutVerts = Brick.Verts.data();
+		int32_t* OutKeys = Brick.EdgeKeys.data();
+		Vec3* OutNormals = Brick.Normals.data();
+		int32_t* OutTris = Brick.Tris.data();
+		int32_t NextVertex = 0;
+		for (int z = Origin[2]; z < EndZ; z++)
+		{
+			for (int y = Origin[1]; y < EndY; y++)
+			{
+				for (int x = Origin[0]; x < EndX; x++)
+				{
+					const int Case = Cases[(x - Origin[0]) + BrickSize * ((y - Origin[1]) + BrickSize * (z - Origin[2]))];
+					if (CaseCounts.Triangles[Case] == 0)
+					{
+						continue;
+					}
+
+					float CubeValues[8];
+					GetCubeIndex(Grid, Density, x, y, z, IsoLevel, CubeValues);
+					const int* Edges = TriTable[Case];
+					const Vec3 CubeOrigin(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+					const auto EmitVertex = [&](int e0, int e1, int32_t EdgeKey)
+					{
+						const float Crossing = GetCrossing(CubeValues[e0], CubeValues[e1], IsoLevel);
+						OutVerts[NextVertex] = InterpolateVertex(e0, e1, Crossing) + CubeOrigin;
+						if (bGradientNormals)
+						{
+							OutNormals[NextVertex] = InterpolateNormal(Grid, Density, x, y, z, e0, e1, Crossing);
+						}
+						OutKeys[NextVertex] = EdgeKey;
+						return NextVertex++;
+					};
+
+					for (int i = 0; Edges[i] != -1; i += 3)
+					{
+						int32_t Corners[3];
+						for (int j = 0; j < 3; j++)
+						{
+							const int Edge = Edges[i + j];
+							const int e0 = EdgeConnections[Edge][0];
+							const int e1 = EdgeConnections[Edge][1];
+							if (!bShareVertices)
+							{
+								Corners[j] = EmitVertex(e0, e1, -1);
+								continue;
+							}
+
+							// Vertices on edges already visited by a neighbouring cube of this brick are reused instead of duplicated
+							const int* Owner = EdgeOwners[Edge];
+							const int OwnerX = x + Owner[0];
+							const int OwnerY = y + Owner[1];
+							const int OwnerZ = z + Owner[2];
+							const int LocalPoint = (OwnerX - Origin[0]) + CachePoints * ((OwnerY - Origin[1]) + CachePoints * (OwnerZ - Origin[2]));
+							int32_t& CachedVertex = Scratch.EdgeCache[LocalPoint * 3 + Owner[3]];
+							if (CachedVertex < 0)
+							{
+								CachedVertex = EmitVertex(e0, e1, Grid.Index(OwnerX, OwnerY, OwnerZ) * 3 + Owner[3]);
+							}
+							Corners[j] = CachedVertex;
+						}
+
+						// Add indices in reverse order to invert the normals.
+						*OutTris++ = Corners[2];
+						*OutTris++ = Corners[1];
+						*OutTris++ = Corners[0];
+					}
+				}
+			}
+		}
+	}
+
+	// The corner at a cube's origin, and the three edges leaving it in positive X, Y and Z with the corners they end at.
+	// A surface net cube owns these edges and emits the quad of every one the surface crosses.
+	constexpr int OriginCorner = 3;
+	constexpr int OriginEdges[3] = { 2, 11, 3 };
+	constexpr int OriginEdgeEnds[3] = { 2, 7, 0 };
+
+	bool HasNetVertex(int Case)
+	{
+		return Case != 0 && Case != 255;
+	}
+
+	// Surface nets also have a cube one outside the chunk on every side. Its corners are clamped to the chunk, so it
+	// collapses onto a border face, edge or corner and only holds a vertex where the surface crosses the border.
+	bool IsBorderNetCube(int LastPoint, int X, int Y, int Z)
+	{
+		return X < 0 || Y < 0 || Z < 0 || X == LastPoint || Y == LastPoint || Z == LastPoint;
+	}
+
+	void GetNetCorner(int LastPoint, int X, int Y, int Z, int Corner, int (&OutPoint)[3])
+	{
+		OutPoint[0] = std::clamp(X + CornerOffsets[Corner][0], 0, LastPoint);
+		OutPoint[1] = std::clamp(Y + CornerOffsets[Corner][1], 0, LastPoint);
+		OutPoint[2] = std::clamp(Z + CornerOffsets[Corner][2], 0, LastPoint);
+	}
+
+	template<typename GridType>
+	int GetNetCubeIndex(const GridType Grid, const float* Density, int X, int Y, int Z, float IsoLevel, float (&CubeValues)[8])
+	{
+		const int LastPoint = Grid.PointsPerAxis - 1;
+		if (!IsBorderNetCube(LastPoint, X, Y, Z))
+		{
+			return GetCubeIndex(Grid, Density, X, Y, Z, IsoLevel, CubeValues);
+		}
+
+		int CubeIndex = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			int Point[3];
+			GetNetCorner(LastPoint, X, Y, Z, i, Point);
+			CubeValues[i] = Density[Grid.Index(Point[0], Point[1], Point[2])];
+			if (CubeValues[i] < IsoLevel) CubeIndex |= 1 << i;
+		}
+		return CubeIndex;
+	}
+
+	// Solves (A + Lambda * I) * X = B for a symmetric A given as XX, XY, XZ, YY, YZ, ZZ, returns false when singular
+	bool SolveRegularized(const float (&A)[6], const Vec3& B, float Lambda, Vec3& OutX)
+	{
+		const float XX = A[0] + Lambda, XY = A[1], XZ = A[2], YY = A[3] + Lambda, YZ = A[4], ZZ = A[5] + Lambda;
+		const float C0 = YY * ZZ - YZ * YZ;
+		const float C1 = XZ * YZ - XY * ZZ;
+		const float C2 = XY * YZ - XZ * YY;
+		const float Det = XX * C0 + XY * C1 + XZ * C2;
+		if (std::abs(Det) < 1.e-12f)
+		{
+			return false;
+		}
+		const float InvDet = 1.0f / Det;
+		OutX.X = (B.X * C0 + B.Y * C1 + B.Z * C2) * InvDet;
+		OutX.Y = (B.X * C1 + B.Y * (XX * ZZ - XZ * XZ) + B.Z * (XY * XZ - XX * YZ)) * InvDet;
+		OutX.Z = (B.X * C2 + B.Y * (XY * XZ - XX * YZ) + B.Z * (XX * YY - XY * XY)) * InvDet;
+		return true;
+	}
+
+	// Places the vertex of a surface net cube relative to the cube origin. Surface nets take the mean of the edge
+	// crossings, dual contouring the point closest to the tangent planes at the crossings, pulled towards that mean so
+	// flat areas stay stable, and kept inside the cube.
+	// Border cubes always take the mean: the gradients on the border are one sided and differ from the neighbouring
+	// chunk's, while the crossings come from the samples both chunks share, so both place the same vertex.
+	template<typename GridType>
+	void PlaceNetVertex(const GridType Grid, const float* Density, float IsoLevel, MeshingMethod Method, bool bGradientNormals,
+		int X, int Y, int Z, int Case, const float (&CubeValues)[8], Vec3& OutPosition, Vec3& OutNormal)
+	{
+		const int LastPoint = Grid.PointsPerAxis - 1;
+		const bool bFitPlanes = Method == MeshingMethod::DualContouring && !IsBorderNetCube(LastPoint, X, Y, Z);
+		const bool bNeedNormals = bGradientNormals || bFitPlanes;
+
+		// Corner positions relative to the cube origin, and their gradients when needed
+		Vec3 Corners[8];
+		Vec3 Gradients[8];
+		for (int i = 0; i < 8; i++)
+		{
+			int Point[3];
+			GetNetCorner(LastPoint, X, Y, Z, i, Point);
+			Corners[i] = Vec3(static_cast<float>(Point[0] - X), static_cast<float>(Point[1] - Y), static_cast<float>(Point[2] - Z));
+			if (bNeedNormals)
+			{
+				Gradients[i] = GetDensityGradient(Grid, Density, Point[0], Point[1], Point[2]);
+			}
+		}
+
+		Vec3 Points[12];
+		Vec3 Normals[12];
+		int NumCrossings = 0;
+		Vec3 Mean;
+		for (int Edge = 0; Edge < 12; Edge++)
+		{
+			const int e0 = EdgeConnections[Edge][0];
+			const int e1 = EdgeConnections[Edge][1];
+			if (((Case >> e0) & 1) == ((Case >> e1) & 1))
+			{
+				continue;
+			}
+			const float Crossing = GetCrossing(CubeValues[e0], CubeValues[e1], IsoLevel);
+			Points[NumCrossings] = Corners[e0] + (Corners[e1] - Corners[e0]) * Crossing;
+			if (bNeedNormals)
+			{
+				Normals[NumCrossings] = BlendGradients(Gradients[e0], Gradients[e1], Crossing);
+			}
+			Mean = Mean + Points[NumCrossings];
+			NumCrossings++;
+		}
+		Mean = Mean * (1.0f / NumCrossings);
+
+		OutPosition = Mean;
+		if (bFitPlanes)
+		{
+			float A[6] = {};
+			Vec3 B;
+			for (int i = 0; i < NumCrossings; i++)
+			{
+				const Vec3& N = Normals[i];
+				const Vec3 Offset = Points[i] - Mean;
+				const float Distance = N.X * Offset.X + N.Y * Offset.Y + N.Z * Offset.Z;
+				A[0] += N.X * N.X; A[1] += N.X * N.Y; A[2] += N.X * N.Z;
+				A[3] += N.Y * N.Y; A[4] += N.Y * N.Z; A[5] += N.Z * N.Z;
+				B = B + N * Distance;
+			}
+			Vec3 Solution;
+			if (SolveRegularized(A, B, 0.05f, Solution))
+			{
+				OutPosition = Vec3(
+					std::clamp(Mean.X + Solution.X, 0.0f, 1.0f),
+					std::clamp(Mean.Y + Solution.Y, 0.0f, 1.0f),
+					std::clamp(Mean.Z + Solution.Z, 0.0f, 1.0f));
+			}
+		}
+
+		if (bGradientNormals)
+		{
+			Vec3 Sum;
+			for (int i = 0; i < NumCrossings; i++)
+			{
+				Sum = Sum + Normals[i];
+			}
+			const float SquareSum = Sum.X * Sum.X + Sum.Y * Sum.Y + Sum.Z * Sum.Z;
+			OutNormal = SquareSum > 1.e-8f ? Sum * (1.0f / std::sqrt(SquareSum)) : Vec3(0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	// Meshes the cubes of one brick as a surface net: a vertex inside every cube the surface crosses, and a quad between
+	// the four cubes around every crossed edge. Quads reach into the cubes one below the brick on each axis, those
+	// vertices are emitted again and welded with the neighbouring brick's by Merge, keyed by cube.
+	// Bricks on the chunk border also own the border cubes outside it (see IsBorderNetCube), so the net reaches the
+	// border and meets the neighbouring chunk's half of the quads there.
+	template<typename GridType>
+	void NetBrickCubes(const GridType Grid, const float* Density, float IsoLevel, MeshingMethod Method, bool bGradientNormals,
+		const int (&Origin)[3], MeshBrick& Brick, MarchScratch& Scratch)
+	{
+		constexpr int BrickSize = Mesher::BrickSize;
+		// The layer below the brick, its cubes and the border cube past the last one
+		constexpr int CachePoints = BrickSize + 2;
+
+		const int LastPoint = Grid.PointsPerAxis - 1;
+		int Begin[3];
+		int End[3];
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			Begin[Axis] = Origin[Axis] == 0 ? -1 : Origin[Axis];
+			End[Axis] = Origin[Axis] + BrickSize >= LastPoint ? LastPoint + 1 : Origin[Axis] + BrickSize;
+		}
+		const auto CacheIndex = [&Origin](int X, int Y, int Z)
+		{
+			return (X - Origin[0] + 1) + CachePoints * ((Y - Origin[1] + 1) + CachePoints * (Z - Origin[2] + 1));
+		};
+		const int KeysPerAxis = Grid.PointsPerAxis + 1;
+		const auto CubeKey = [KeysPerAxis](int X, int Y, int Z)
+		{
+			return (X + 1) + KeysPerAxis * ((Y + 1) + KeysPerAxis * (Z + 1));
+		};
+
+		// Classify the brick's cubes and the layer below them
+		Scratch.CubeCases.resize(CachePoints * CachePoints * CachePoints);
+		uint8_t* Cases = Scratch.CubeCases.data();
+		for (int z = Origin[2] - 1; z < End[2]; z++)
+		{
+			for (int y = Origin[1] - 1; y < End[1]; y++)
+			{
+				for (int x = Origin[0] - 1; x < End[0]; x++)
+				{
+					float CubeValues[8];
+					Cases[CacheIndex(x, y, z)] = static_cast<uint8_t>(GetNetCubeIndex(Grid, Density, x, y, z, IsoLevel, CubeValues));
+				}
+			}
+		}
+
+		// Count the brick's own vertices, its quads and the vertices below the brick they reach.
+		// Cubes before the chunk have no edges in it, and the edges of the ones past it that point out of the chunk
+		// collapse to a point and are never crossed.
+		constexpr int32_t Unused = -1;
+		constexpr int32_t Referenced = -2;
+		Scratch.EdgeCache.assign(CachePoints * CachePoints * CachePoints, Unused);
+		int32_t* CubeVertices = Scratch.EdgeCache.data();
+		int32_t NumOwnedVerts = 0;
+		int32_t NumVerts = 0;
+		int32_t NumQuads = 0;
+		for (int z = Begin[2]; z < End[2]; z++)
+		{
+			for (int y = Begin[1]; y < End[1]; y++)
+			{
+				for (int x = Begin[0]; x < End[0]; x++)
+				{
+					const int Case = Cases[CacheIndex(x, y, z)];
+					if (!HasNetVertex(Case))
+					{
+						continue;
+					}
+					NumOwnedVerts++;
+					if (x < 0 || y < 0 || z < 0)
+					{
+						continue;
+					}
+
+					for (int Axis = 0; Axis < 3; Axis++)
+					{
+						const int U = (Axis + 1) % 3;
+						const int V = (Axis + 2) % 3;
+						if (((Case >> OriginCorner) & 1) == ((Case >> OriginEdgeEnds[Axis]) & 1))
+						{
+							continue;
+						}
+						NumQuads++;
+						for (int Corner = 1; Corner < 4; Corner++)
+						{
+							int Neighbour[3] = { x, y, z };
+							Neighbour[U] -= Corner == 1 || Corner == 2;
+							Neighbour[V] -= Corner == 2 || Corner == 3;
+							int32_t& Vertex = CubeVertices[CacheIndex(Neighbour[0], Neighbour[1], Neighbour[2])];
+							const bool bBelowBrick = Neighbour[U] < Begin[U] || Neighbour[V] < Begin[V];
+							if (bBelowBrick && Vertex == Unused)
+							{
+								Vertex = Referenced;
+								NumVerts++;
+							}
+						}
+					}
+				}
+			}
+		}
+		NumVerts += NumOwnedVerts;
+		if (NumQuads == 0 && NumOwnedVerts == 0)
+		{
+			return;
+		}
+
+		Brick.Verts.resize(NumVerts);
+		Brick.EdgeKeys.resize(NumVerts);
+		Brick.Tris.resize(NumQuads * 6);
+		Brick.Normals.resize(bGradientNormals ? NumVerts : 0);
+		Brick.NumOwnedVerts = NumOwnedVerts;
+
+		int32_t NextVertex = 0;
+		const auto EmitVertex = [&](int X, int Y, int Z)
+		{
+			float CubeValues[8];
+			const int Case = GetNetCubeIndex(Grid, Density, X, Y, Z, IsoLevel, CubeValues);
+			Vec3 Position;
+			Vec3 Normal;
+			PlaceNetVertex(Grid, Density, IsoLevel, Method, bGradientNormals, X, Y, Z, Case, CubeValues, Position, Normal);
+			Brick.Verts[NextVertex] = Position + Vec3(static_cast<float>(X), static_cast<float>(Y), static_cast<float>(Z));
+			if (bGradientNormals)
+			{
+				Brick.Normals[NextVertex] = Normal;
+			}
+			Brick.EdgeKeys[NextVertex] = CubeKey(X, Y, Z);
+			return NextVertex++;
+		};
+
+		// Every cube the surface crosses is emitted by its own brick, whether or not one of its quads is
+		for (int z = Begin[2]; z < End[2]; z++)
+		{
+			for (int y = Begin[1]; y < End[1]; y++)
+			{
+				for (int x = Begin[0]; x < End[0]; x++)
+				{
+					if (HasNetVertex(Cases[CacheIndex(x, y, z)]))
+					{
+						CubeVertices[CacheIndex(x, y, z)] = EmitVertex(x, y, z);
+					}
+				}
+			}
+		}
+
+		int32_t* OutTris = Brick.Tris.data();
+		for (int z = std::max(Begin[2], 0); z < End[2]; z++)
+		{
+			for (int y = std::max(Begin[1], 0); y < End[1]; y++)
+			{
+				for (int x = std::max(Begin[0], 0); x < End[0]; x++)
+				{
+					const int Case = Cases[CacheIndex(x, y, z)];
+					if (!HasNetVertex(Case))
+					{
+						continue;
+					}
+
+					for (int Axis = 0; Axis < 3; Axis++)
+					{
+						const int U = (Axis + 1) % 3;
+						const int V = (Axis + 2) % 3;
+						const bool bOriginInside = ((Case >> OriginCorner) & 1) != 0;
+						if (bOriginInside == (((Case >> OriginEdgeEnds[Axis]) & 1) != 0))
+						{
+							continue;
+						}
+
+						// The four cubes around the edge in order, wound so the quad faces away from the ground
+						int32_t Quad[4];
+						for (int Corner = 0; Corner < 4; Corner++)
+						{
+							int Neighbour[3] = { x, y, z };
+							Neighbour[U] -= Corner == 1 || Corner == 2;
+							Neighbour[V] -= Corner == 2 || Corner == 3;
+							int32_t& Vertex = CubeVertices[CacheIndex(Neighbour[0], Neighbour[1], Neighbour[2])];
+							if (Vertex < 0)
+							{
+								Vertex = EmitVertex(Neighbour[0], Neighbour[1], Neighbour[2]);
+							}
+							Quad[Corner] = Vertex;
+						}
+						if (!bOriginInside)
+						{
+							std::swap(Quad[1], Quad[3]);
+						}
+						*OutTris++ = Quad[0];
+						*OutTris++ = Quad[1];
+						*OutTris++ = Quad[2];
+						*OutTris++ = Quad[0];
+						*OutTris++ = Quad[2];
+						*OutTris++ = Quad[3];
+					}
+				}
+			}
+		}
+	}
+}
+
+Mesher::Mesher(int InPointsPerAxis)
+	: PointsPerAxis(InPointsPerAxis)
+	, BricksPerAxis((InPointsPerAxis - 1 + BrickSize - 1) / BrickSize)
+{
+}
+
+void Mesher::BuildBrickSummary(const float* Density)
+{
+	BrickRanges.resize(GetNumBricks());
+	DispatchGrid(PointsPerAxis, [this, Density](auto Grid)
+	{
+		for (int BrickZ = 0; BrickZ < BricksPerAxis; BrickZ++)
+		{
+			for (int BrickY = 0; BrickY < BricksPerAxis; BrickY++)
+			{
+				for (int BrickX = 0; BrickX < BricksPerAxis; BrickX++)
+				{
+					BrickRanges[GetBrickIndex(BrickX, BrickY, BrickZ)] = SummarizeBrick(Grid, Density, BrickX, BrickY, BrickZ);
+				}
+			}
+		}
+	});
+	UpdateDensityRange();
+}
+
+void Mesher::UpdateDensityRange()
+{
+	Range = DensityRange();
+	for (const DensityRange& BrickRange : BrickRanges)
+	{
+		Range.Include(BrickRange);
+	}
+}
+
+void Mesher::MarchBrick(const float* Density, int BrickIndex, MarchScratch& Scratch)
+{
+	MeshBrick& Brick = Bricks[BrickIndex];
+	Brick.Reset();
+
+	// Bricks the surface cannot cross are skipped as a whole
+	if (!BrickRanges[BrickIndex].Crosses(IsoLevel))
+	{
+		return;
+	}
+
+	const int Origin[3] = {
+		(BrickIndex % BricksPerAxis) * BrickSize,
+		(BrickIndex / BricksPerAxis % BricksPerAxis) * BrickSize,
+		(BrickIndex / (BricksPerAxis * BricksPerAxis)) * BrickSize
+	};
+	DispatchGrid(PointsPerAxis, [&](auto Grid)
+	{
+		if (Method == MeshingMethod::MarchingCubes)
+		{
+			MarchBrickCubes(Grid, Density, IsoLevel, bShareVertices, bGradientNormals, Origin, Brick, Scratch);
+		}
+		else
+		{
+			NetBrickCubes(Grid, Density, IsoLevel, Method, bGradientNormals, Origin, Brick, Scratch);
+		}
+	});
+}
+
+void Mesher::MarchBrickLayer(const float* Density, int BrickZ)
+{
+	MarchScratch Scratch;
+	for (int BrickY = 0; BrickY < BricksPerAxis; BrickY++)
+	{
+		for (int BrickX = 0; BrickX < BricksPerAxis; BrickX++)
+		{
+			MarchBrick(Density, GetBrickIndex(BrickX, BrickY, BrickZ), Scratch);
+		}
+	}
+}
+
+void Mesher::MarchAll(const float* Density)
+{
+	ResetBricks();
+	if (!HasSurface())
+	{
+		return;
+	}
+	for (int BrickZ = 0; BrickZ < BricksPerAxis; BrickZ++)
+	{
+		MarchBrickLayer(Density, BrickZ);
+	}
+}
+
+void Mesher::ResetBricks()
+{
+	Bricks.resize(GetNumBricks());
+	for (MeshBrick& Brick : Bricks)
+	{
+		Brick.Reset();
+	}
+	DirtyBricks.assign(GetNumBricks(), false);
+}
+
+void Mesher::MarkPointsDirty(int MinX, int MinY, int MinZ, int MaxX, int MaxY, int MaxZ)
+{
+	if (DirtyBricks.size() != static_cast<size_t>(GetNumBricks()))
+	{
+		DirtyBricks.assign(GetNumBricks(), false);
+	}
+
+	// A point on a brick border is read by the bricks on both sides of it
+	const int MinBrickX = std::max(MinX - 1, 0) / BrickSize;
+	const int MinBrickY = std::max(MinY - 1, 0) / BrickSize;
+	const int MinBrickZ = std::max(MinZ - 1, 0) / BrickSize;
+	const int MaxBrickX = std::min(MaxX / BrickSize, BricksPerAxis - 1);
+	const int MaxBrickY = std::min(MaxY / BrickSize, BricksPerAxis - 1);
+	const int MaxBrickZ = std::min(MaxZ / BrickSize, BricksPerAxis - 1);
+
+	for (int BrickZ = MinBrickZ; BrickZ <= MaxBrickZ; BrickZ++)
+	{
+		for (int BrickY = MinBrickY; BrickY <= MaxBrickY; BrickY++)
+		{
+			for (int BrickX = MinBrickX; BrickX <= MaxBrickX; BrickX++)
+			{
+				DirtyBricks[GetBrickIndex(BrickX, BrickY, BrickZ)] = true;
+			}
+		}
+	}
+}
+
+std::vector<int> Mesher::TakeDirtyBricks(const float* Density)
+{
+	std::vector<int> Dirty;
+	for (int BrickIndex = 0; BrickIndex < static_cast<int>(DirtyBricks.size()); BrickIndex++)
+	{
+		if (!DirtyBricks[BrickIndex])
+		{
+			continue;
+		}
+		DirtyBricks[BrickIndex] = false;
+		Dirty.push_back(BrickIndex);
+
+		const int BrickX = BrickIndex % BricksPerAxis;
+		const int BrickY = BrickIndex / BricksPerAxis % BricksPerAxis;
+		const int BrickZ = BrickIndex / (BricksPerAxis * BricksPerAxis);
+		DispatchGrid(PointsPerAxis, [&](auto Grid)
+		{
+			BrickRanges[BrickIndex] = SummarizeBrick(Grid, Density, BrickX, BrickY, BrickZ);
+		});
+	}
+	if (!Dirty.empty())
+	{
+		UpdateDensityRange();
+	}
+	return Dirty;
+}
+
+int32_t Mesher::GetNumMergedVerts() const
+{
+	int32_t NumVerts = 0;
+	for (const MeshBrick& Brick : Bricks)
+	{
+		NumVerts += Brick.NumOwnedVerts;
+	}
+	return NumVerts;
+}
+
+int32_t Mesher::GetNumMergedIndices() const
+{
+	int32_t NumIndices = 0;
+	for (const MeshBrick& Brick : Bricks)
+	{
+		NumIndices += static_cast<int32_t>(Brick.Tris.size());
+	}
+	return NumIndices;
+}
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "MarchingTypes.h"
+
+namespace MarchingCore
+{
+
+// Surface extraction algorithm of a mesher, all of them read the same density and fill the same brick output
+enum class MeshingMethod : uint8_t
+{
+	// Up to five triangles per cube from the case tables, vertices on the cube edges
+	MarchingCubes,
+	// One vertex per crossed cube at the mean of its edge crossings and one quad per crossed edge, about half the
+	// triangles of marching cubes and far fewer slivers. Always indexed, on the chunk border the vertices lie on the
+	// border plane and match the neighbouring chunk's.
+	SurfaceNets,
+	// Surface nets with every vertex fitted to the density gradient planes at its crossings, keeps sharp features
+	DualContouring
+};
+
+// Mesh output of a single brick, merged into the chunk mesh in brick order.
+// Kept after meshing, so an edit only re-marches the bricks it touched and merges the rest as they are.
+struct MeshBrick
+{
+	std::vector<Vec3> Verts;
+	std::vector<int32_t> Tris;
+
+	// Chunk wide key (point index * 3 + axis) of the edge each vertex lies on, or the index of the cube it lies in for
+	// surface nets (counting the border cubes before the chunk, so from -1 to PointsPerAxis - 1 on each axis), welds
+	// vertices shared with neighbouring bricks. -1 for the unshared vertices of a triangle soup.
+	std::vector<int32_t> EdgeKeys;
+	// Normal of every vertex from the density gradient, empty unless the mesher computes gradient normals
+	std::vector<Vec3> Normals;
+
+	// Vertices this brick contributes to the merged mesh, the ones on its far faces belong to the next brick
+	int32_t NumOwnedVerts = 0;
+
+	void Reset()
+	{
+		Verts.clear();
+		Tris.clear();
+		EdgeKeys.clear();
+		Normals.clear();
+		NumOwnedVerts = 0;
+	}
+};
+
+// Scratch memory of one marching thread, reused from brick to brick
+struct MarchScratch
+{
+	// Cube configuration of every cube of the brick, classified by the counting pass and emitted by the second one
+	std::vector<uint8_t> CubeCases;
+	std::vector<int32_t> EdgeCache;
+};
+
+// Marching cubes over a cubic density grid, split into bricks of BrickSize^3 cubes.
+// Bricks the surface cannot cross are skipped using a min/max summary of their densities, and the output of every brick
+// is cached so edits only re-march the bricks they touched.
+// Different bricks can be marched from different threads, everything else must be called from one thread at a time.
+class Mesher
+{
+public:
+	// Number of cubes along each axis of a brick, the unit of empty space skipping and of remeshing
+	static constexpr int BrickSize = 4;
+
+	explicit Mesher(int InPointsPerAxis);
+
+	float IsoLevel = 0.5f;
+	// When enabled, neighbouring triangles share the vertex on their common edge, producing an indexed mesh.
+	// Only affects marching cubes, surface nets are always indexed.
+	bool bShareVertices = true;
+	// When enabled, every vertex gets a normal from the density gradient at its edge while marching, smooth even for a
+	// triangle soup and merged alongside the positions
+	bool bGradientNormals = false;
+	MeshingMethod Method = MeshingMethod::MarchingCubes;
+
+	int GetPointsPerAxis() const { return PointsPerAxis; }
+	int GetBricksPerAxis() const { return BricksPerAxis; }
+	int GetNumBricks() const { return BricksPerAxis * BricksPerAxis * BricksPerAxis; }
+	int GetBrickIndex(int BrickX, int BrickY, int BrickZ) const { return BrickX + BricksPerAxis * (BrickY + BricksPerAxis * BrickZ); }
+
+	// Recomputes the density range of every brick, needed whenever the density changed outside of an edit
+	void BuildBrickSummary(const float* Density);
+	bool HasBrickSummary() const { return !BrickRanges.empty(); }
+	bool HasSurface() const { return Range.Crosses(IsoLevel); }
+
+	// Marches one brick into its cached output, sized exactly by a counting pass before anything is emitted
+	void MarchBrick(const float* Density, int BrickIndex, MarchScratch& Scratch);
+	void MarchBrickLayer(const float* Density, int BrickZ);
+	// Marches every brick on the calling thread
+	void MarchAll(const float* Density);
+	void ResetBricks();
+	bool HasBeenMarched() const { return Bricks.size() == static_cast<size_t>(GetNumBricks()); }
+
+	// Flags the bricks reading any of the grid points in [Min, Max]
+	void MarkPointsDirty(int MinX, int MinY, int MinZ, int MaxX, int MaxY, int MaxZ);
+	// Refreshes the density range of the dirty bricks, clears their flags and returns their indices to be re-marched
+	std::vector<int> TakeDirtyBricks(const float* Density);
+
+	// Exact size of the merged mesh
+	int32_t GetNumMergedVerts() const;
+	int32_t GetNumMergedIndices() const;
+
+	// Welds the output of all bricks into one indexed mesh in brick order, so the result does not depend on how the
+	// bricks were scheduled. OutVerts must hold GetNumMergedVerts and OutTris GetNumMergedIndices elements, OutNormals
+	// (only written with gradient normals) as many as OutVerts. Returns the number of vertices written.
+	template<typename VectorType, typename NormalType = VectorType>
+	int32_t Merge(VectorType* OutVerts, int32_t* OutTris, NormalType* OutNormals = nullptr) const;
+
+	const MeshBrick& GetBrick(int BrickIndex) const { return Bricks[BrickIndex]; }
+
+private:
+	void UpdateDensityRange();
+
+	int PointsPerAxis;
+	int BricksPerAxis;
+
+	std::vector<DensityRange> BrickRanges;
+	DensityRange Range;
+	std::vector<MeshBrick> Bricks;
+	std::vector<bool> DirtyBricks;
+	// Merged vertex of every edge or cube key, all -1 between merges. Allocated by the first merge that welds and kept,
+	// so a remesh after a small edit doesn't fill the whole table again.
+	mutable std::vector<int32_t> WeldTable;
+};
+
+template<typename VectorType, typename NormalType>
+int32_t Mesher::Merge(VectorType* OutVerts, int32_t* OutTris, NormalType* OutNormals) const
+{
+	// Edges on a brick face were crossed by the bricks on both sides, the first one merged keeps its vertex.
+	// Surface nets always weld, their bricks emit the cubes below them again whether or not vertices are shared.
+	const bool bWeld = bShareVertices || Method != MeshingMethod::MarchingCubes;
+	std::vector<int32_t>& EdgeVertices = WeldTable;
+	if (bWeld && EdgeVertices.empty())
+	{
+		const size_t NumEdges = static_cast<size_t>(PointsPerAxis) * PointsPerAxis * PointsPerAxis * 3;
+		const size_t NumCubes = static_cast<size_t>(PointsPerAxis + 1) * (PointsPerAxis + 1) * (PointsPerAxis + 1);
+		EdgeVertices.assign(std::max(NumEdges, NumCubes), -1);
+	}
+
+	int32_t NumVerts = 0;
+	int32_t NumIndices = 0;
+	const bool bMergeNormals = bGradientNormals && OutNormals != nullptr;
+	std::vector<int32_t> Remap;
+	for (const MeshBrick& Brick : Bricks)
+	{
+		Remap.resize(Brick.Verts.size());
+		for (size_t i = 0; i < Brick.Verts.size(); i++)
+		{
+			const int32_t Key = Brick.EdgeKeys[i];
+			if (Key >= 0 && EdgeVertices[Key] >= 0)
+			{
+				Remap[i] = EdgeVertices[Key];
+				continue;
+			}
+
+			const Vec3& Vert = Brick.Verts[i];
+			OutVerts[NumVerts] = VectorType(Vert.X, Vert.Y, Vert.Z);
+			if (bMergeNormals)
+			{
+				const Vec3& Normal = Brick.Normals[i];
+				OutNormals[NumVerts] = NormalType(Normal.X, Normal.Y, Normal.Z);
+			}
+			Remap[i] = NumVerts;
+			if (Key >= 0)
+			{
+				EdgeVertices[Key] = NumVerts;
+			}
+			NumVerts++;
+		}
+		for (int32_t Index : Brick.Tris)
+		{
+			OutTris[NumIndices++] = Remap[Index];
+		}
+	}
+
+	// Only the keys of the merged vertices were written, clearing them costs as much as the mesh rather than the grid
+	if (bWeld)
+	{
+		for (const MeshBrick& Brick : Bricks)
+		{
+			for (const int32_t Key : Brick.EdgeKeys)
+			{
+				if (Key >= 0)
+				{
+					EdgeVertices[Key] = -1;
+				}
+			}
+		}
+	}
+	return NumVerts;
+}
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "CompactDensity.h"
+
+namespace MarchingCore
+{
+
+// Layout of a region file, which keeps the saved chunks of a ChunksPerAxis^3 block of chunk coordinates.
+// A fixed table of one entry per chunk follows the header, the chunk blobs follow the table in any order. Only saved
+// chunks have a blob, so a file grows with the edited area rather than with the region. Every chunk alternates between two
+// slots: a save writes the slot the entry doesn't point at, appending a bigger one when the blob outgrew it, and only
+// then points the entry at it. A save cut short leaves the entry on the last whole blob.
+namespace RegionFile
+{
+	constexpr uint32_t Magic = 0x4752434D; // "MCRG"
+	constexpr uint16_t Version = 2;
+	constexpr int ChunksPerAxis = 16;
+	constexpr int NumEntries = ChunksPerAxis * ChunksPerAxis * ChunksPerAxis;
+	// Blobs get their capacity in whole blocks, so a chunk saved again after a few more edits usually fits in place
+	constexpr uint32_t BlobAlignment = 4096;
+
+	struct Header
+	{
+		uint32_t Magic = RegionFile::Magic;
+		uint16_t Version = RegionFile::Version;
+		uint16_t ChunksPerAxis = RegionFile::ChunksPerAxis;
+		// Chunks saved with another resolution can't be read back
+		int32_t PointsPerChunk = 0;
+		uint32_t Reserved = 0;
+	};
+
+	struct Entry
+	{
+		// Byte offset of the blob from the start of the file, 0 when the chunk was never saved
+		uint32_t Offset = 0;
+		uint32_t Capacity = 0;
+		// Bytes used of the capacity, the blob starts with its uncompressed size as a uint32
+		uint32_t Size = 0;
+		// Sequence of the last journal edit folded into the blob, edits after it are replayed on load
+		uint32_t Sequence = 0;
+		// The other slot, holding the previous blob, 0 until the chunk was saved twice
+		uint32_t SpareOffset = 0;
+		uint32_t SpareCapacity = 0;
+
+		bool IsSaved() const { return Offset != 0; }
+	};
+
+	constexpr uint32_t TableOffset = sizeof(Header);
+	constexpr uint32_t DataOffset = TableOffset + NumEntries * sizeof(Entry);
+
+	// Region a chunk coordinate falls into, rounding towards negative infinity
+	inline int ToRegionCoord(int ChunkCoord)
+	{
+		return ChunkCoord >= 0 ? ChunkCoord / ChunksPerAxis : (ChunkCoord + 1) / ChunksPerAxis - 1;
+	}
+
+	// Table index of a chunk inside its region, indexed like the density grids
+	inline int GetEntryIndex(int ChunkX, int ChunkY, int ChunkZ)
+	{
+		const int LocalX = ChunkX - ToRegionCoord(ChunkX) * ChunksPerAxis;
+		const int LocalY = ChunkY - ToRegionCoord(ChunkY) * ChunksPerAxis;
+		const int LocalZ = ChunkZ - ToRegionCoord(ChunkZ) * ChunksPerAxis;
+		return LocalX + ChunksPerAxis * (LocalY + ChunksPerAxis * LocalZ);
+	}
+
+	inline uint32_t GetEntryOffset(int EntryIndex)
+	{
+		return TableOffset + static_cast<uint32_t>(EntryIndex) * sizeof(Entry);
+	}
+
+	inline uint32_t AlignCapacity(uint32_t Size)
+	{
+		return (Size + BlobAlignment - 1) / BlobAlignment * BlobAlignment;
+	}
+
+	// The Size bytes of a file start with a whole table and a header this build reads, for chunks of PointsPerChunk points
+	inline bool IsCompatible(const uint8_t* Data, size_t Size, int PointsPerChunk)
+	{
+		if (Size < DataOffset)
+		{
+			return false;
+		}
+		RegionFile::Header FileHeader;
+		std::memcpy(&FileHeader, Data, sizeof(FileHeader));
+		return FileHeader.Magic == Magic && FileHeader.Version == Version && FileHeader.ChunksPerAxis == ChunksPerAxis
+			&& FileHeader.PointsPerChunk == PointsPerChunk;
+	}
+
+	// Table entry of a saved chunk in a compatible file of Size bytes, false when the chunk was never saved or the entry
+	// points outside the data
+	inline bool ReadEntry(const uint8_t* Data, size_t Size, int EntryIndex, Entry& OutEntry)
+	{
+		std::memcpy(&OutEntry, Data + GetEntryOffset(EntryIndex), sizeof(OutEntry));
+		return OutEntry.IsSaved() && OutEntry.Offset >= DataOffset && OutEntry.Size >= sizeof(uint32_t)
+			&& OutEntry.Size <= OutEntry.Capacity && static_cast<uint64_t>(OutEntry.Offset) + OutEntry.Size <= Size;
+	}
+
+	// Uncompressed size a blob starts with, false unless it is one CompactDensity serializes for PointsPerChunk points.
+	// Checked before it is allocated, a damaged file must not make us allocate whatever it claims.
+	inline bool ReadUncompressedSize(const uint8_t* Blob, size_t Size, int PointsPerChunk, uint32_t& OutSize)
+	{
+		if (Size < sizeof(uint32_t))
+		{
+			return false;
+		}
+		std::memcpy(&OutSize, Blob, sizeof(uint32_t));
+		return CompactDensity::IsSerializedSize(OutSize, PointsPerChunk);
+	}
+}
+
+}
@@ -0,0 +1,134 @@
+#include "TerrainDensity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../Utility/FastNoiseGrid.h"
+
+namespace MarchingCore
+{
+
+TerrainDensity::TerrainDensity(const TerrainSettings& InSettings, int InPointsPerChunk)
+	: Settings(InSettings)
+	, PointsPerChunk(InPointsPerChunk)
+{
+	Noise.SetSeed(Settings.Seed);
+	Noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+	Noise.SetFractalType(FastNoiseLite::FractalType_Ridged);
+	Noise.SetFrequency(Settings.Frequency);
+	Noise.SetFractalOctaves(Settings.Octaves);
+}
+
+void TerrainDensity::FillChunk(float* OutDensity, int ChunkX, int ChunkY, int ChunkZ, uint8_t SkipBorders) const
+{
+	const float OriginX = GetChunkOrigin(ChunkX);
+	const float OriginY = GetChunkOrigin(ChunkY);
+	const float OriginZ = GetChunkOrigin(ChunkZ);
+	const int PointsPerLayer = PointsPerChunk * PointsPerChunk;
+
+	if (SkipBorders == 0)
+	{
+		// Sample the whole noise grid in one batched call, then add the height based shaping once per layer
+		FastNoiseGrid::GenUniformGrid3D(Noise, OutDensity, OriginX, OriginY, OriginZ, PointsPerChunk, PointsPerChunk, PointsPerChunk);
+
+		for (int z = 0; z < PointsPerChunk; z++)
+		{
+			const float Shape = GetShapeDensity(OriginZ + z);
+			float* Layer = OutDensity + z * PointsPerLayer;
+			for (int i = 0; i < PointsPerLayer; i++)
+			{
+				Layer[i] = Layer[i] * Settings.Amplitude + Shape;
+			}
+		}
+		return;
+	}
+
+	// Only the layers and rows between the skipped planes are sampled. Rows keep their full length, one or two points
+	// less still take as many SIMD blocks, so copied X border points are saved and put back instead of skipped.
+	const bool bKeepMinX = (SkipBorders & GetBorderBit(0, false)) != 0;
+	const bool bKeepMaxX = (SkipBorders & GetBorderBit(0, true)) != 0;
+	const int MinY = (SkipBorders & GetBorderBit(1, false)) ? 1 : 0;
+	const int MaxY = (SkipBorders & GetBorderBit(1, true)) ? PointsPerChunk - 2 : PointsPerChunk - 1;
+	const int MinZ = (SkipBorders & GetBorderBit(2, false)) ? 1 : 0;
+	const int MaxZ = (SkipBorders & GetBorderBit(2, true)) ? PointsPerChunk - 2 : PointsPerChunk - 1;
+	const int NumRows = MaxY - MinY + 1;
+	std::vector<float> KeptX(bKeepMinX || bKeepMaxX ? 2 * NumRows : 0);
+
+	for (int z = MinZ; z <= MaxZ; z++)
+	{
+		float* Rows = OutDensity + PointsPerChunk * MinY + PointsPerLayer * z;
+		for (int y = 0; y < NumRows && !KeptX.empty(); y++)
+		{
+			KeptX[2 * y] = Rows[PointsPerChunk * y];
+			KeptX[2 * y + 1] = Rows[PointsPerChunk * y + PointsPerChunk - 1];
+		}
+
+		FastNoiseGrid::GenUniformGrid3D(Noise, Rows, OriginX, OriginY + MinY, OriginZ + z, PointsPerChunk, NumRows, 1);
+		const float Shape = GetShapeDensity(OriginZ + z);
+		for (int i = 0; i < PointsPerChunk * NumRows; i++)
+		{
+			Rows[i] = Rows[i] * Settings.Amplitude + Shape;
+		}
+
+		for (int y = 0; y < NumRows && !KeptX.empty(); y++)
+		{
+			if (bKeepMinX)
+			{
+				Rows[PointsPerChunk * y] = KeptX[2 * y];
+			}
+			if (bKeepMaxX)
+			{
+				Rows[PointsPerChunk * y + PointsPerChunk - 1] = KeptX[2 * y + 1];
+			}
+		}
+	}
+}
+
+float TerrainDensity::GetDensity(int ChunkX, int ChunkY, int ChunkZ, float X, float Y, float Z) const
+{
+	const float WorldZ = Z + GetChunkOrigin(ChunkZ);
+	float NoiseValue = Noise.GetNoise(X + GetChunkOrigin(ChunkX),
+									Y + GetChunkOrigin(ChunkY),
+									WorldZ) * Settings.Amplitude;
+
+	return NoiseValue + GetShapeDensity(WorldZ);
+}
+
+DensityRange TerrainDensity::GetChunkBounds(int ChunkZ) const
+{
+	// The fractal noise is normalized to [-1, 1] before it is scaled by the amplitude
+	const float OriginZ = GetChunkOrigin(ChunkZ);
+	const float NoiseExtent = std::abs(Settings.Amplitude);
+	DensityRange Bounds;
+	for (int z = 0; z < PointsPerChunk; z++)
+	{
+		const float Shape = GetShapeDensity(OriginZ + z);
+		Bounds.Include(Shape - NoiseExtent);
+		Bounds.Include(Shape + NoiseExtent);
+	}
+	return Bounds;
+}
+
+void TerrainDensity::FillChunkShape(float* OutDensity, int ChunkZ) const
+{
+	const float OriginZ = GetChunkOrigin(ChunkZ);
+	const int PointsPerLayer = PointsPerChunk * PointsPerChunk;
+	for (int z = 0; z < PointsPerChunk; z++)
+	{
+		std::fill_n(OutDensity + z * PointsPerLayer, PointsPerLayer, GetShapeDensity(OriginZ + z));
+	}
+}
+
+float TerrainDensity::GetShapeDensity(float Z) const
+{
+	float Ground = -Z + (Settings.GroundPercent * PointsPerChunk);
+	float HardFloorInfluence = std::clamp((Settings.HardFloorZ - Z) * 3.0f, 0.0f, 1.0f) * 40.0f; // Adjust the multiplier as needed
+	// Floored, so the terraces keep their step below zero
+	const int Terrace = static_cast<int>(std::floor(Z)) % Settings.TerraceHeight;
+	float Terracing = static_cast<float>(Terrace < 0 ? Terrace + Settings.TerraceHeight : Terrace);
+
+	return Ground + HardFloorInfluence + Terracing;
+}
+
+}
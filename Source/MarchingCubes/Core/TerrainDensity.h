@@ -0,0 +1,71 @@
+#pragma once
+
+#include "MarchingTypes.h"
+// Third party code, its cellular noise trips GCC's loop overflow analysis
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Waggressive-loop-optimizations"
+#endif
+#include "../Utility/FastNoiseLite.h"
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic pop
+#endif
+
+namespace MarchingCore
+{
+
+// Parameters the terrain density is built from
+struct TerrainSettings
+{
+	int Seed = 1337;
+	float Amplitude = 5.0f;
+	float Frequency = 0.005f;
+	int Octaves = 8;
+	float GroundPercent = 0.2f;
+	float HardFloorZ = 3.f;
+	int TerraceHeight = 5;
+};
+
+// Ridged noise shaped by a ground level, a hard floor and terraces.
+// Chunks are laid out in all three axes and sampled in world units, so the terrain can span any number of chunks vertically.
+// Configured once on construction and immutable afterwards, so it can be sampled from any thread.
+class TerrainDensity
+{
+public:
+	TerrainDensity(const TerrainSettings& InSettings, int InPointsPerChunk);
+
+	// Fills the PointsPerChunk^3 density grid of a chunk, indexed x + N * (y + N * z).
+	// Border planes flagged in SkipBorders (see GetBorderBit) are left untouched, they were copied from a neighbour that
+	// shares them and don't have to be sampled again.
+	void FillChunk(float* OutDensity, int ChunkX, int ChunkY, int ChunkZ, uint8_t SkipBorders = 0) const;
+
+	// Density of a single point of a chunk
+	float GetDensity(int ChunkX, int ChunkY, int ChunkZ, float X, float Y, float Z) const;
+
+	// Bounds of every density FillChunk can produce in the layer of chunks at ChunkZ, from the shaping of its heights
+	// widened by the noise amplitude. Chunks far above or below the ground don't cross any iso level inside these bounds.
+	DensityRange GetChunkBounds(int ChunkZ) const;
+
+	// Fills the chunk with the height shaping only, for chunks whose bounds show the noise can't move any of their
+	// points across the iso level
+	void FillChunkShape(float* OutDensity, int ChunkZ) const;
+
+	// Bit of the border plane of a chunk on the Positive or negative side of Axis (0 = X, 1 = Y, 2 = Z)
+	static constexpr uint8_t GetBorderBit(int Axis, bool bPositive) { return static_cast<uint8_t>(1u << (Axis * 2 + (bPositive ? 1 : 0))); }
+
+	const TerrainSettings& GetSettings() const { return Settings; }
+	int GetPointsPerChunk() const { return PointsPerChunk; }
+
+private:
+	// Ground, hard floor and terracing terms, these only depend on the world height of a point
+	float GetShapeDensity(float Z) const;
+
+	// Chunks share their border points, so neighbouring chunks are PointsPerChunk - 1 points apart
+	float GetChunkOrigin(int ChunkCoord) const { return static_cast<float>(ChunkCoord * (PointsPerChunk - 1)); }
+
+	TerrainSettings Settings;
+	int PointsPerChunk;
+	FastNoiseLite Noise;
+};
+
+}
@@ -0,0 +1,250 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MarchingBenchCommandlet.h"
+
+#include "MarchingChunk.h"
+#include "Core/MeshSkirts.h"
+#include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMarchingBench, Log, All);
+
+namespace MarchingBench
+{
+	// Seconds spent in every stage for one chunk, plus what it produced
+	struct FChunkTimings
+	{
+		FIntVector Coord;
+		double Noise = 0.0;
+		double BrickSummary = 0.0;
+		double March = 0.0;
+		double MeshAssembly = 0.0;
+		double Normals = 0.0;
+		double UVs = 0.0;
+		int32 NumVerts = 0;
+		int32 NumTriangles = 0;
+
+		double Total() const { return Noise + BrickSummary + March + MeshAssembly + Normals + UVs; }
+	};
+
+	// Chunks are laid out row by row and layer by layer in a cube around the origin, so the block holds chunks above,
+	// below and across the surface like the streamed one around the player
+	FIntVector GetChunkCoord(int Index, int NumChunks)
+	{
+		const int Side = FMath::CeilToInt(FMath::Pow(static_cast<float>(NumChunks), 1.0f / 3.0f) - KINDA_SMALL_NUMBER);
+		return FIntVector(Index % Side - Side / 2, Index / Side % Side - Side / 2, Index / (Side * Side) - Side / 2);
+	}
+
+	double Time(TFunctionRef<void()> Stage)
+	{
+		const double Start = FPlatformTime::Seconds();
+		Stage();
+		return FPlatformTime::Seconds() - Start;
+	}
+}
+
+UMarchingBenchCommandlet::UMarchingBenchCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMarchingBenchCommandlet::Main(const FString& Params)
+{
+	using namespace MarchingBench;
+
+	int NumChunks = 64;
+	int NumWarmupChunks = 4;
+	FParse::Value(*Params, TEXT("Chunks="), NumChunks);
+	FParse::Value(*Params, TEXT("Warmup="), NumWarmupChunks);
+	NumChunks = FMath::Max(NumChunks, 1);
+	NumWarmupChunks = FMath::Max(NumWarmupChunks, 0);
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Profiling") / TEXT("MarchingBench.json");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	TSubclassOf<AMarchingChunk> ChunkClass = AMarchingChunk::StaticClass();
+	FString ChunkClassPath;
+	if (FParse::Value(*Params, TEXT("ChunkClass="), ChunkClassPath))
+	{
+		ChunkClass = LoadClass<AMarchingChunk>(nullptr, *ChunkClassPath);
+		if (!ChunkClass)
+		{
+			UE_LOG(LogMarchingBench, Error, TEXT("Could not load chunk class %s"), *ChunkClassPath);
+			return 1;
+		}
+	}
+
+	// The chunks never render or tick, they only need a world to be spawned in
+	UWorld* World = UWorld::CreateWorld(EWorldType::None, false, TEXT("MarchingBench"));
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags = RF_Transient;
+	AMarchingChunk* Chunk = World->SpawnActor<AMarchingChunk>(ChunkClass, FTransform::Identity, SpawnParams);
+	if (!Chunk)
+	{
+		UE_LOG(LogMarchingBench, Error, TEXT("Could not spawn a chunk"));
+		World->DestroyWorld(false);
+		return 1;
+	}
+
+	// Command line values override the defaults of the chunk class
+	FParse::Value(*Params, TEXT("Seed="), Chunk->Seed);
+	FParse::Value(*Params, TEXT("Amplitude="), Chunk->Amplitude);
+	FParse::Value(*Params, TEXT("Frequency="), Chunk->Frequency);
+	FParse::Value(*Params, TEXT("Octaves="), Chunk->Octaves);
+	FParse::Value(*Params, TEXT("IsoLevel="), Chunk->IsoLevel);
+	Chunk->bParallelMeshing = !FParse::Param(*Params, TEXT("SingleThread"));
+	if (FParse::Param(*Params, TEXT("GradientNormals")))
+	{
+		Chunk->bGradientNormals = true;
+	}
+	FString MeshingMethod;
+	if (FParse::Value(*Params, TEXT("MeshingMethod="), MeshingMethod))
+	{
+		const int64 Method = StaticEnum<EMeshingMethod>()->GetValueByNameString(MeshingMethod);
+		if (Method == INDEX_NONE)
+		{
+			UE_LOG(LogMarchingBench, Error, TEXT("Unknown meshing method %s"), *MeshingMethod);
+			World->DestroyWorld(false);
+			return 1;
+		}
+		Chunk->MeshingMethod = static_cast<EMeshingMethod>(Method);
+	}
+	int PointsPerChunk = Chunk->GridMetrics.GetPointsPerChunk();
+	if (FParse::Value(*Params, TEXT("PointsPerChunk="), PointsPerChunk))
+	{
+		Chunk->SetResolution(PointsPerChunk <= 16 ? EChunkResolution::Points16 : PointsPerChunk <= 32 ? EChunkResolution::Points32 : EChunkResolution::Points64);
+	}
+	int LODStride = 1;
+	if (FParse::Value(*Params, TEXT("LODStride="), LODStride))
+	{
+		Chunk->SetLOD(LODStride, LODStride > 1 ? MarchingCore::MeshSkirts::AllFaces : 0);
+	}
+	Chunk->SetTerrainGenerator(MakeShared<const FTerrainGenerator>(Chunk->MakeTerrainSettings(), Chunk->GridMetrics));
+
+	// One chunk is regenerated at every coordinate, the way a pooled chunk is reused while streaming
+	auto GenerateChunk = [Chunk](const FIntVector& Coord)
+	{
+		FChunkTimings Timings;
+		Timings.Coord = Coord;
+		Chunk->InitialX = Coord.X;
+		Chunk->InitialY = Coord.Y;
+		Chunk->InitialZ = Coord.Z;
+
+		// The two halves of PopulateTerrainMap, the summary is what lets the march skip empty bricks
+		Timings.Noise = Time([Chunk] { Chunk->FillDensity(); });
+		Timings.BrickSummary = Time([Chunk] { Chunk->BuildBrickSummary(); });
+		Timings.March = Time([Chunk] { Chunk->MarchBricks(); });
+		Timings.MeshAssembly = Time([Chunk] { Chunk->MergeMeshBricks(); });
+		Timings.Normals = Time([Chunk] { Chunk->GenerateNormals(); });
+		Timings.UVs = Time([Chunk] { Chunk->UVMap = Chunk->GenerateUVMap(); });
+
+		Timings.NumVerts = Chunk->Verts.Num();
+		Timings.NumTriangles = Chunk->GetTriangleCount();
+		return Timings;
+	};
+
+	for (int i = 0; i < NumWarmupChunks; i++)
+	{
+		GenerateChunk(GetChunkCoord(i, NumWarmupChunks));
+	}
+
+	TArray<FChunkTimings> Results;
+	Results.Reserve(NumChunks);
+	for (int i = 0; i < NumChunks; i++)
+	{
+		Results.Add(GenerateChunk(GetChunkCoord(i, NumChunks)));
+	}
+
+	FChunkTimings Sum;
+	int64 NumVerts = 0;
+	int64 NumTriangles = 0;
+	for (const FChunkTimings& Timings : Results)
+	{
+		Sum.Noise += Timings.Noise;
+		Sum.BrickSummary += Timings.BrickSummary;
+		Sum.March += Timings.March;
+		Sum.MeshAssembly += Timings.MeshAssembly;
+		Sum.Normals += Timings.Normals;
+		Sum.UVs += Timings.UVs;
+		NumVerts += Timings.NumVerts;
+		NumTriangles += Timings.NumTriangles;
+	}
+	const double TotalSeconds = Sum.Total();
+	const double TrianglesPerSecond = TotalSeconds > 0.0 ? NumTriangles / TotalSeconds : 0.0;
+	const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+
+	FString Report;
+	if (OutputPath.EndsWith(TEXT(".csv")))
+	{
+		// One row per chunk, times in milliseconds
+		Report = TEXT("ChunkX,ChunkY,ChunkZ,NoiseMs,BrickSummaryMs,MarchMs,MeshAssemblyMs,NormalsMs,UVsMs,TotalMs,Vertices,Triangles\n");
+		for (const FChunkTimings& Timings : Results)
+		{
+			Report += FString::Printf(TEXT("%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%d,%d\n"),
+				Timings.Coord.X, Timings.Coord.Y, Timings.Coord.Z,
+				Timings.Noise * 1000.0, Timings.BrickSummary * 1000.0, Timings.March * 1000.0, Timings.MeshAssembly * 1000.0,
+				Timings.Normals * 1000.0, Timings.UVs * 1000.0, Timings.Total() * 1000.0,
+				Timings.NumVerts, Timings.NumTriangles);
+		}
+	}
+	else
+	{
+		TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+		Root->SetNumberField(TEXT("Chunks"), NumChunks);
+		Root->SetNumberField(TEXT("PointsPerChunk"), Chunk->GridMetrics.GetPointsPerChunk());
+		Root->SetNumberField(TEXT("Distance"), Chunk->GridMetrics.GetDistance());
+		Root->SetNumberField(TEXT("Seed"), Chunk->Seed);
+		Root->SetNumberField(TEXT("Amplitude"), Chunk->Amplitude);
+		Root->SetNumberField(TEXT("Frequency"), Chunk->Frequency);
+		Root->SetNumberField(TEXT("Octaves"), Chunk->Octaves);
+		Root->SetNumberField(TEXT("IsoLevel"), Chunk->IsoLevel);
+		Root->SetBoolField(TEXT("ParallelMeshing"), Chunk->bParallelMeshing);
+		Root->SetBoolField(TEXT("ShareVertices"), Chunk->bShareVertices);
+		Root->SetBoolField(TEXT("GradientNormals"), Chunk->bGradientNormals);
+		Root->SetNumberField(TEXT("LODStride"), Chunk->GetLODStride());
+		Root->SetStringField(TEXT("MeshingMethod"), StaticEnum<EMeshingMethod>()->GetNameStringByValue(static_cast<int64>(Chunk->MeshingMethod)));
+
+		// Milliseconds summed over all chunks
+		TSharedRef<FJsonObject> Stages = MakeShared<FJsonObject>();
+		Stages->SetNumberField(TEXT("Noise"), Sum.Noise * 1000.0);
+		Stages->SetNumberField(TEXT("BrickSummary"), Sum.BrickSummary * 1000.0);
+		Stages->SetNumberField(TEXT("March"), Sum.March * 1000.0);
+		Stages->SetNumberField(TEXT("MeshAssembly"), Sum.MeshAssembly * 1000.0);
+		Stages->SetNumberField(TEXT("Normals"), Sum.Normals * 1000.0);
+		Stages->SetNumberField(TEXT("UVs"), Sum.UVs * 1000.0);
+		Root->SetObjectField(TEXT("StageMs"), Stages);
+
+		Root->SetNumberField(TEXT("TotalMs"), TotalSeconds * 1000.0);
+		Root->SetNumberField(TEXT("MsPerChunk"), TotalSeconds * 1000.0 / NumChunks);
+		Root->SetNumberField(TEXT("Vertices"), NumVerts);
+		Root->SetNumberField(TEXT("Triangles"), NumTriangles);
+		Root->SetNumberField(TEXT("TrianglesPerSecond"), TrianglesPerSecond);
+		Root->SetNumberField(TEXT("PeakUsedPhysicalBytes"), MemoryStats.PeakUsedPhysical);
+		Root->SetNumberField(TEXT("PeakUsedVirtualBytes"), MemoryStats.PeakUsedVirtual);
+
+		const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Report);
+		FJsonSerializer::Serialize(Root, Writer);
+	}
+
+	UE_LOG(LogMarchingBench, Display, TEXT("%d chunks in %.2f ms (noise %.2f, brick summary %.2f, march %.2f, mesh assembly %.2f, normals %.2f, UVs %.2f), %lld triangles, %.0f triangles/s, peak memory %llu MB"),
+		NumChunks, TotalSeconds * 1000.0, Sum.Noise * 1000.0, Sum.BrickSummary * 1000.0, Sum.March * 1000.0, Sum.MeshAssembly * 1000.0,
+		Sum.Normals * 1000.0, Sum.UVs * 1000.0, NumTriangles, TrianglesPerSecond,
+		static_cast<uint64>(MemoryStats.PeakUsedPhysical / (1024 * 1024)));
+
+	Chunk->Destroy();
+	World->DestroyWorld(false);
+
+	if (!FFileHelper::SaveStringToFile(Report, *OutputPath))
+	{
+		UE_LOG(LogMarchingBench, Error, TEXT("Could not write %s"), *OutputPath);
+		return 1;
+	}
+	UE_LOG(LogMarchingBench, Display, TEXT("Wrote %s"), *OutputPath);
+	return 0;
+}
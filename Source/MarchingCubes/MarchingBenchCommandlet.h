@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MarchingBenchCommandlet.generated.h"
+
+// Generates chunks without a viewport and reports how long every stage of the pipeline took.
+//
+// UnrealEditor-Cmd MarchingCubes.uproject -run=MarchingBench [-Chunks=64] [-Warmup=4] [-Seed=1337] [-Amplitude=5]
+//     [-Frequency=0.005] [-Octaves=8] [-IsoLevel=0.5] [-PointsPerChunk=16|32|64] [-ChunkClass=/Game/BP_Chunk.BP_Chunk_C] [-SingleThread]
+//     [-GradientNormals] [-LODStride=1|2|4|8] [-MeshingMethod=MarchingCubes|SurfaceNets|DualContouring] [-Output=Saved/Profiling/MarchingBench.json|.csv]
+UCLASS()
+class MARCHINGCUBES_API UMarchingBenchCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UMarchingBenchCommandlet();
+	virtual int32 Main(const FString& Params) override;
+};
@@ -3,8 +3,20 @@
 
 #include "MarchingChunk.h"
 
-#include "Utility/MarchingTable.h"
+#include "ChunkMeshCache.h"
+#include "ChunkRegionStore.h"
+#include "Core/DensityMip.h"
+#include "Core/MeshDecimation.h"
+#include "Core/MeshNormals.h"
+#include "Core/MeshSkirts.h"
+#include "MarchingRegion.h"
 #include "DrawDebugHelpers.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Hash/CityHash.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMarchingChunk, Log, All);
 
 AMarchingChunk::AMarchingChunk()
 {
@@ -13,10 +25,47 @@ AMarchingChunk::AMarchingChunk()
 	ProceduralMesh = CreateDefaultSubobject<UProceduralMeshComponent>("ProceduralMesh");
 	RootComponent = ProceduralMesh;
 	
-	ProceduralMesh->SetRelativeScale3D(FVector(GridMetrics.Distance));
+	ProceduralMesh->SetRelativeScale3D(FVector(GridMetrics.GetDistance()));
+
+	CollisionMesh = CreateDefaultSubobject<UProceduralMeshComponent>("CollisionMesh");
+	CollisionMesh->SetupAttachment(ProceduralMesh);
+	CollisionMesh->SetVisibility(false);
+	CollisionMesh->bUseAsyncCooking = true;
+}
+
+void AMarchingChunk::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	// The resolution comes from the class defaults, which are only applied after the constructor ran
+	SetResolution(Resolution);
+}
+
+void AMarchingChunk::SetResolution(EChunkResolution InResolution)
+{
+	check(!bIsGenerating);
+	Resolution = InResolution;
+	GridMetrics = FGridMetrics(Resolution);
 
 	// Initialize size of array to number of cubes in our grid (x * y * z)
-	Weights.SetNum(GridMetrics.PointsPerChunk * GridMetrics.PointsPerChunk * GridMetrics.PointsPerChunk);
+	CompactWeights.Reset();
+	Weights.SetNum(GridMetrics.GetNumPoints());
+	Mesher = MarchingCore::Mesher(GridMetrics.GetPointsPerChunk());
+	SetLOD(LODStride, SkirtFaces);
+}
+
+void AMarchingChunk::SetLOD(int InLODStride, uint8 InSkirtFaces)
+{
+	check(!bIsGenerating);
+	LODStride = FMath::Clamp(InLODStride, 1, GridMetrics.GetPointsPerChunk() - 1);
+	SkirtFaces = InSkirtFaces;
+
+	const int MipPoints = MarchingCore::DensityMip::GetPointsPerAxis(GridMetrics.GetPointsPerChunk(), LODStride);
+	if (LODStride > 1 && LODMesher.GetPointsPerAxis() != MipPoints)
+	{
+		LODMesher = MarchingCore::Mesher(MipPoints);
+		LODWeights.SetNumUninitialized(MipPoints * MipPoints * MipPoints);
+	}
 }
 
 void AMarchingChunk::BeginPlay()
@@ -25,91 +74,147 @@ void AMarchingChunk::BeginPlay()
 
 	//Seed = FMath::Rand();
 
-	UE_LOG(LogTemp, Warning, TEXT("X: %i, Y: %i"), InitialX, InitialY);
+	UE_LOG(LogMarchingChunk, Verbose, TEXT("Chunk began play at X: %i, Y: %i, Z: %i"), InitialX, InitialY, InitialZ);
 	//DrawDebugBoxes();
 }
 
+bool AMarchingChunk::IsReadyForFinishDestroy()
+{
+	// The background stages work on this chunk's buffers, so it is only freed once they are done. Their commit only
+	// holds a weak pointer and skips a chunk that was destroyed in the meantime.
+	return Super::IsReadyForFinishDestroy() && GenerationTask.IsCompleted();
+}
+
 void AMarchingChunk::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 }
 
-void AMarchingChunk::March(FVector id)
+void AMarchingChunk::GenerateAsync(bool bPopulateDensity)
 {
-	// Check whether we are inside of our grid
-	if (id.X >= (GridMetrics.PointsPerChunk - 1) || id.Y >= (GridMetrics.PointsPerChunk) - 1 || id.Z >= (GridMetrics.PointsPerChunk - 1))
+	check(IsInGameThread());
+	if (bIsGenerating)
 	{
 		return;
 	}
+	bIsGenerating = true;
 
-	// Next, get the noise values at the corners of our cubes
-	float CubeValues[8] = {
-		Weights[IndexFromCoord(id.X,		id.Y,		  id.Z + 1)],
-		Weights[IndexFromCoord(id.X + 1,	id.Y,		  id.Z + 1)],
-		Weights[IndexFromCoord(id.X + 1,	id.Y,			id.Z)],
-		Weights[IndexFromCoord(id.X,		id.Y,			id.Z)],
-		Weights[IndexFromCoord(id.X,		id.Y + 1,	  id.Z + 1)],
-		Weights[IndexFromCoord(id.X + 1,	id.Y + 1,	  id.Z + 1)],
-		Weights[IndexFromCoord(id.X + 1,	id.Y + 1,		id.Z)],
-		Weights[IndexFromCoord(id.X,		id.Y + 1,		id.Z)]
-	 };
-
-	// Get the cube configuration
-	int CubeIndex = 0;
-	if (CubeValues[0] < IsoLevel) CubeIndex |= 1;
-	if (CubeValues[1] < IsoLevel) CubeIndex |= 2;
-	if (CubeValues[2] < IsoLevel) CubeIndex |= 4;
-	if (CubeValues[3] < IsoLevel) CubeIndex |= 8;
-	if (CubeValues[4] < IsoLevel) CubeIndex |= 16;
-	if (CubeValues[5] < IsoLevel) CubeIndex |= 32;
-	if (CubeValues[6] < IsoLevel) CubeIndex |= 64;
-	if (CubeValues[7] < IsoLevel) CubeIndex |= 128;
-
-	// Get the triangle indices
-	const int* Edges = TriTable[CubeIndex];
-	
-	for (int i = 0; Edges[i] != -1; i += 3)
+	// Density, meshing and normals/UVs run as a chain of background tasks, only the commit touches the component
+	UE::Tasks::FTask DensityTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, bPopulateDensity]
 	{
-		// First edge lies between vertex e00 and vertex e01
-		int e00 = EdgeConnections[Edges[i]][0];
-		int e01 = EdgeConnections[Edges[i]][1];
+		// A cached mesh stands in for the density, the meshing and the normals
+		bMeshFromCache = false;
+		if (LoadCachedMesh(bPopulateDensity))
+		{
+			return;
+		}
 
-		// Second edge lies between vertex e10 and vertex e11
-		int e10 = EdgeConnections[Edges[i + 1]][0];
-		int e11 = EdgeConnections[Edges[i + 1]][1];
+		if (bPopulateDensity)
+		{
+			PopulateTerrainMap();
+		}
+		else
+		{
+			BuildBrickSummary();
+		}
+	});
+	UE::Tasks::FTask MeshTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this]
+	{
+		if (!bMeshFromCache)
+		{
+			MarchCells();
+		}
+	}, UE::Tasks::Prerequisites(DensityTask));
 
-		// Third edge lies between vertex e20 and vertex e21
-		int e20 = EdgeConnections[Edges[i + 2]][0];
-		int e21 = EdgeConnections[Edges[i + 2]][1];
+	TWeakObjectPtr<AMarchingChunk> WeakThis(this);
+	GenerationTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, WeakThis]
+	{
+		if (!bMeshFromCache)
+		{
+			GenerateNormalsAndUVs();
+			StoreCachedMesh();
+		}
 
-		FTriangle Tri;
+		AsyncTask(ENamedThreads::GameThread, [WeakThis]
+		{
+			if (AMarchingChunk* Chunk = WeakThis.Get())
+			{
+				Chunk->CommitGeneratedMesh();
+			}
+		});
+	}, UE::Tasks::Prerequisites(MeshTask));
+}
 
-		// Interpolate between the points on the edge to find the exact position for the vertices of the triangles
-		Tri.a = InterpolateVertex(CornerOffsets[e00], CubeValues[e00], CornerOffsets[e01], CubeValues[e01]) + id;
-		Tri.b = InterpolateVertex(CornerOffsets[e10], CubeValues[e10], CornerOffsets[e11], CubeValues[e11]) + id;
-		Tri.c = InterpolateVertex(CornerOffsets[e20], CubeValues[e20], CornerOffsets[e21], CubeValues[e21]) + id;
-		
-		// Add our triangle to the list.
-		Triangles.Add(Tri);
+void AMarchingChunk::CommitGeneratedMesh()
+{
+	check(IsInGameThread());
+	bIsGenerating = false;
+
+	// Retired while generating, the result belongs to coordinates nobody wants anymore
+	if (bIsPooled)
+	{
+		return;
 	}
+
+	// Strokes made while generating are in the journal already, they only have to reach the density and the mesh
+	if (DeferredEdits.Num() > 0)
+	{
+		for (const MarchingCore::BrushEdit& Edit : DeferredEdits)
+		{
+			AddBrushEditToDensity(Edit);
+		}
+		DeferredEdits.Empty();
+		RemeshDirtyBricks();
+		return;
+	}
+	ConstructMesh();
 }
 
-void AMarchingChunk::UpdateMesh()
+void AMarchingChunk::ReleaseToPool()
+{
+	bIsPooled = true;
+	SharedBorders = 0;
+	DeferredEdits.Empty();
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+
+	// Only the render and collision data is dropped, Weights and the mesh buffers keep their allocation and are
+	// overwritten by the next generation (a pending one may still be writing to them)
+	if (ProceduralMesh)
+	{
+		ProceduralMesh->ClearAllMeshSections();
+	}
+	ClearCollision();
+}
+
+void AMarchingChunk::ReturnFromPool()
+{
+	bIsPooled = false;
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+}
+
+void AMarchingChunk::SetRegion(AMarchingRegion* InRegion)
 {
+	Region = InRegion;
+
+	// A batched chunk keeps its component only as its root and the region draws it, collision stays on CollisionMesh
 	if (ProceduralMesh)
 	{
-		// Update the procedural mesh component with the modified vertex data
+		ProceduralMesh->ClearAllMeshSections();
+		ProceduralMesh->SetVisibility(Region == nullptr);
+	}
+}
 
-		// Recalculate normals
-		Normals = CalcAverageNormals(Verts, Tris);
-		
-		// Notify the procedural mesh component that it needs to update
-		ProceduralMesh->UpdateMeshSection(0, Verts, 	Normals,
-		UVMap,
-		TArray<FColor>(),
-		TArray<FProcMeshTangent>());
+void AMarchingChunk::UpdateMesh()
+{
+	if (ProceduralMesh)
+	{
+		// Recalculate normals, the vertices were moved so the density gradient no longer matches them
+		CalcAverageNormals(Verts, Tris, Normals);
 
-		ProceduralMesh->SetMaterial(0, Material);
+		// Rebuild the section with the modified vertex data
+		ConstructMesh();
 	}
 }
 
@@ -127,86 +232,543 @@ void AMarchingChunk::ClearMesh()
 
 int AMarchingChunk::IndexFromCoord(int x, int y, int z) const
 {
-	return x + GridMetrics.PointsPerChunk * (y + GridMetrics.PointsPerChunk * z);
+	return GridMetrics.Index(x, y, z);
 }
 
-FVector AMarchingChunk::InterpolateVertex(FVector edgeVertex1, float valueAtVertex1, FVector edgeVertex2, float valueAtVertex2) const
+void AMarchingChunk::PopulateTerrainMap()
 {
-	return (edgeVertex1 + (IsoLevel - valueAtVertex1) * (edgeVertex2 - edgeVertex1) / (valueAtVertex2 - valueAtVertex1));
+	FillDensity();
+	BuildBrickSummary();
 }
 
-void AMarchingChunk::PopulateTerrainMap()
+void AMarchingChunk::FillDensity()
 {
-	if (Weights.Num() == 0) {
+	PrepareDensityForFill();
+	bDensityPending = false;
+	bDensityQuantized = false;
+	bSavedDensityLossy = false;
+	bHasDensityEdits = false;
+
+	// A saved chunk comes back with its edits instead of the noise, falling back to the noise if its blob is damaged
+	bool bLoaded = false;
+	if (SavedDensity.Num() > 0)
+	{
+		bool bExact = true;
+		bLoaded = FChunkRegionStore::DecodeChunk(SavedDensity, GridMetrics.GetPointsPerChunk(), Weights.GetData(), &bExact);
+		SavedDensity.Empty();
+
+		// Snapshots saved quantized by older builds stay out of border sharing like compressed chunks
+		bSavedDensityLossy = bLoaded && !bExact;
+	}
+	if (bLoaded)
+	{
+		bHasSampledDensity = true;
+	}
+	else
+	{
+		// A chunk placed on its own has no generator handed to it, it builds one from its own properties
+		if (!TerrainGenerator.IsValid())
+		{
+			TerrainGenerator = MakeShared<const FTerrainGenerator>(MakeTerrainSettings(), GridMetrics);
+		}
+		bHasSampledDensity = TerrainGenerator->FillChunkDensity(Weights.GetData(), GetChunkCoord(), IsoLevel, ReplayedEdits.Num() > 0 ? 0 : SharedBorders);
+	}
+	SharedBorders = 0;
+
+	// Edits made after the saved density was written, in the order they were made
+	const FIntVector Coord = GetChunkCoord();
+	for (const MarchingCore::BrushEdit& Edit : ReplayedEdits)
+	{
+		int Min[3];
+		int Max[3];
+		if (MarchingCore::GetBrushBox(Edit, Coord.X, Coord.Y, Coord.Z, GridMetrics.GetPointsPerChunk(), Min, Max))
+		{
+			MarchingCore::ApplyBrushEdit(Edit, Coord.X, Coord.Y, Coord.Z, GridMetrics.GetPointsPerChunk(), Weights.GetData(), Min, Max);
+		}
+	}
+	bHasDensityEdits = bLoaded || ReplayedEdits.Num() > 0;
+	ReplayedEdits.Empty();
+}
+
+void AMarchingChunk::CopySharedBorder(const AMarchingChunk& Neighbour, const FIntVector& Offset)
+{
+	check(!bIsGenerating);
+	const int N = GridMetrics.GetPointsPerChunk();
+	if (Neighbour.GridMetrics.GetPointsPerChunk() != N || FMath::Abs(Offset.X) + FMath::Abs(Offset.Y) + FMath::Abs(Offset.Z) != 1)
+	{
 		return;
 	}
-	
-	for (int x = 0; x < GridMetrics.PointsPerChunk; x++)
+	const int Axis = Offset.X != 0 ? 0 : (Offset.Y != 0 ? 1 : 2);
+	const bool bPositive = Offset[Axis] > 0;
+
+	PrepareDensityForFill();
+
+	// Our last plane along the axis is the neighbour's first one and the other way around
+	const int Plane = bPositive ? N - 1 : 0;
+	const int NeighbourPlane = N - 1 - Plane;
+	for (int v = 0; v < N; v++)
 	{
-		for (int y = 0; y < GridMetrics.PointsPerChunk; y++)
+		for (int u = 0; u < N; u++)
 		{
-			for (int z = 0; z < GridMetrics.PointsPerChunk; z++)
-			{
-				int index = x + GridMetrics.PointsPerChunk * (y + GridMetrics.PointsPerChunk * z);
-				Weights[index] = GenerateNoise(FVector(x, y, z));
-			}
+			FIntVector Point;
+			Point[Axis] = Plane;
+			Point[(Axis + 1) % 3] = u;
+			Point[(Axis + 2) % 3] = v;
+			FIntVector NeighbourPoint = Point;
+			NeighbourPoint[Axis] = NeighbourPlane;
+			Weights[IndexFromCoord(Point.X, Point.Y, Point.Z)] = Neighbour.GetWeight(Neighbour.IndexFromCoord(NeighbourPoint.X, NeighbourPoint.Y, NeighbourPoint.Z));
 		}
 	}
+	SharedBorders |= MarchingCore::TerrainDensity::GetBorderBit(Axis, bPositive);
+}
+
+void AMarchingChunk::SetSavedDensity(TArray<uint8>&& Blob)
+{
+	check(!bIsGenerating);
+	SavedDensity = MoveTemp(Blob);
+}
+
+void AMarchingChunk::SetReplayedEdits(TArray<MarchingCore::BrushEdit>&& Edits)
+{
+	check(!bIsGenerating);
+	ReplayedEdits = MoveTemp(Edits);
+}
+
+bool AMarchingChunk::ApplyBrushEdit(const MarchingCore::BrushEdit& Edit)
+{
+	const FIntVector Coord = GetChunkCoord();
+	int Min[3];
+	int Max[3];
+	if (!MarchingCore::GetBrushBox(Edit, Coord.X, Coord.Y, Coord.Z, GridMetrics.GetPointsPerChunk(), Min, Max))
+	{
+		return false;
+	}
+
+	// Background generation owns the chunk's buffers until it commits, which applies the stroke then
+	if (bIsGenerating)
+	{
+		DeferredEdits.Add(Edit);
+		return true;
+	}
+
+	AddBrushEditToDensity(Edit);
+	RemeshDirtyBricks();
+	return true;
+}
+
+void AMarchingChunk::AddBrushEditToDensity(const MarchingCore::BrushEdit& Edit)
+{
+	// Only the points inside the brush's bounding box, clamped to our grid
+	const FIntVector Coord = GetChunkCoord();
+	int Min[3];
+	int Max[3];
+	if (!MarchingCore::GetBrushBox(Edit, Coord.X, Coord.Y, Coord.Z, GridMetrics.GetPointsPerChunk(), Min, Max))
+	{
+		return;
+	}
+	// The chunk no longer matches what the cache holds for its coordinates
+	MeshCache.Reset();
+	if (bMeshFromCache)
+	{
+		// A cached mesh left the mesher without the brick output RemeshDirtyBricks splices into
+		BuildBrickSummary();
+		MarchCells();
+	}
+	// Distant chunks may keep their density compressed, edits work on the floats
+	ExpandDensity();
+	MarchingCore::ApplyBrushEdit(Edit, Coord.X, Coord.Y, Coord.Z, GridMetrics.GetPointsPerChunk(), Weights.GetData(), Min, Max);
+	bHasDensityEdits = true;
+
+	// Re-march only the bricks the brush touched
+	MarkPointsDirty(FIntVector(Min[0], Min[1], Min[2]), FIntVector(Max[0], Max[1], Max[2]));
+}
+
+void AMarchingChunk::SetMeshCache(TSharedPtr<const FChunkMeshCache> InMeshCache)
+{
+	check(!bIsGenerating);
+	MeshCache = MoveTemp(InMeshCache);
+}
+
+bool AMarchingChunk::LoadCachedMesh(bool bDeferDensity)
+{
+	if (!MeshCache || !MeshCache->Load(GetMeshSettingsHash(), GetChunkCoord(), Verts, Tris, Normals))
+	{
+		return false;
+	}
+	// The grid UVs are built per point rather than per vertex, they are left out of the cache and ConstructMesh skips them
+	UVMap.Reset();
+	bMeshFromCache = true;
+	if (bDeferDensity)
+	{
+		bDensityPending = true;
+		bHasSampledDensity = false;
+	}
+	return true;
 }
 
-void AMarchingChunk::GenerateMeshData(TArray<FTriangle> triangles)
+void AMarchingChunk::StoreCachedMesh() const
 {
-	// Invert the normals by changing the order of vertex indices in Tris array.
-	// Instead of adding the indices in order, add them in reverse order.
-	for (int32 i = 0; i < triangles.Num(); i++)
+	// The cache stands in for the noise, a mesh of quantized density would outlive the loss
+	if (MeshCache && !bDensityQuantized)
 	{
-		int32 startIndex = i * 3;
+		MeshCache->Store(GetMeshSettingsHash(), GetChunkCoord(), Verts, Tris, Normals);
+	}
+}
 
-		Verts.Add(FVector(triangles[i].a.X, triangles[i].a.Y, triangles[i].a.Z));
-		Verts.Add(FVector(triangles[i].b.X, triangles[i].b.Y, triangles[i].b.Z));
-		Verts.Add(FVector(triangles[i].c.X, triangles[i].c.Y, triangles[i].c.Z));
+uint64 AMarchingChunk::GetMeshSettingsHash() const
+{
+	FTerrainSettings Settings = TerrainGenerator.IsValid() ? TerrainGenerator->GetSettings() : MakeTerrainSettings();
+	int32 PointsPerChunk = GridMetrics.GetPointsPerChunk();
+	float Distance = GridMetrics.GetDistance();
+	uint32 CacheVersion = FChunkMeshCache::Version;
+	float Iso = IsoLevel;
+	uint8 Method = static_cast<uint8>(MeshingMethod);
+	bool bShared = bShareVertices;
+	bool bGradient = bGradientNormals;
+	int32 Stride = LODStride;
+	uint8 Skirts = SkirtFaces;
+
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	Writer << CacheVersion;
+	Writer << Settings.Seed << Settings.Amplitude << Settings.Frequency << Settings.Octaves << Settings.GroundPercent
+		<< Settings.HardFloorZ << Settings.TerraceHeight;
+	Writer << PointsPerChunk << Distance;
+	Writer << Iso << Method << bShared << bGradient << Stride << Skirts;
+	return CityHash64(reinterpret_cast<const char*>(Bytes.GetData()), Bytes.Num());
+}
 
-		// Add indices in reverse order to invert the normals.
-		Tris.Add(startIndex + 2);
-		Tris.Add(startIndex + 1);
-		Tris.Add(startIndex);
+void AMarchingChunk::PrepareDensityForFill()
+{
+	CompactWeights.Reset();
+	Weights.SetNumUninitialized(GridMetrics.GetNumPoints());
+}
+
+void AMarchingChunk::CompressDensity(MarchingCore::DensityEncoding Quantization)
+{
+	check(!bIsGenerating);
+	if (IsDensityCompressed() || bDensityPending)
+	{
+		return;
+	}
+	CompactWeights.Compress(Weights.GetData(), GridMetrics.GetPointsPerChunk(), IsoLevel, Quantization);
+	bDensityQuantized |= !CompactWeights.IsExact();
+	Weights.Empty();
+}
+
+void AMarchingChunk::ExpandDensity()
+{
+	if (!IsDensityCompressed())
+	{
+		return;
+	}
+	Weights.SetNumUninitialized(GridMetrics.GetNumPoints());
+	CompactWeights.Decompress(Weights.GetData());
+	CompactWeights.Reset();
+}
+
+void AMarchingChunk::SetTerrainGenerator(TSharedPtr<const FTerrainGenerator> InTerrainGenerator)
+{
+	check(!bIsGenerating);
+	TerrainGenerator = MoveTemp(InTerrainGenerator);
+}
+
+FTerrainSettings AMarchingChunk::MakeTerrainSettings() const
+{
+	FTerrainSettings Settings;
+	Settings.Seed = Seed;
+	Settings.Amplitude = Amplitude;
+	Settings.Frequency = Frequency;
+	Settings.Octaves = Octaves;
+	Settings.GroundPercent = GroundPercent;
+	Settings.HardFloorZ = HardFloorZ;
+	Settings.TerraceHeight = TerraceHeight;
+	return Settings;
+}
+
+void AMarchingChunk::BuildBrickSummary()
+{
+	// A chunk whose mesh came from the cache fills its density on first use
+	if (bDensityPending)
+	{
+		PopulateTerrainMap();
+		return;
+	}
+	ExpandDensity();
+
+	// Coarse chunks resample Weights first, so they always march the latest edits
+	if (LODStride > 1)
+	{
+		MarchingCore::DensityMip::Downsample(Weights.GetData(), GridMetrics.GetPointsPerChunk(), LODStride, LODWeights.GetData());
+		LODMesher.BuildBrickSummary(LODWeights.GetData());
+		return;
+	}
+	Mesher.BuildBrickSummary(Weights.GetData());
+}
+
+void AMarchingChunk::GenerateNormalsAndUVs()
+{
+	GenerateNormals();
+	// After the normals, so the skirts neither bend the normals along the border nor need their own
+	if (SkirtFaces != 0)
+	{
+		AppendSkirts();
 	}
-	Normals = CalcAverageNormals(Verts, Tris);
 	UVMap = GenerateUVMap();
+}
+
+void AMarchingChunk::AppendSkirts()
+{
+	// Deep enough to cover the largest difference between the surface at this stride and at full resolution
+	const float Extent = static_cast<float>(GridMetrics.GetPointsPerChunk() - 1);
+	const float Depth = 2.0f * LODStride;
+
+	const int32 NumVerts = Verts.Num();
+	const int32 NumIndices = Tris.Num();
+	const int32 NumEdges = MarchingCore::MeshSkirts::CountEdges(Verts.GetData(), Tris.GetData(), NumIndices, Extent, SkirtFaces);
+	Verts.SetNumUninitialized(NumVerts + NumEdges * 2, false);
+	Normals.SetNumUninitialized(Verts.Num(), false);
+	Tris.SetNumUninitialized(NumIndices + NumEdges * 6, false);
+	MarchingCore::MeshSkirts::Append(Verts.GetData(), Normals.GetData(), NumVerts, Tris.GetData(), NumIndices, Extent, Depth, SkirtFaces);
+}
+
+void AMarchingChunk::GenerateNormals()
+{
+	if (!bGradientNormals)
+	{
+		CalcAverageNormals(Verts, Tris, Normals);
+	}
+}
+
+void AMarchingChunk::ConfigureMesher()
+{
+	MarchingCore::Mesher& ActiveMesher = GetActiveMesher();
+	ActiveMesher.IsoLevel = IsoLevel;
+	ActiveMesher.bShareVertices = bShareVertices;
+	ActiveMesher.bGradientNormals = bGradientNormals;
+	ActiveMesher.Method = static_cast<MarchingCore::MeshingMethod>(MeshingMethod);
+}
+
+void AMarchingChunk::MarchCells()
+{
+	bMeshFromCache = false;
+	MarchBricks();
+
+	// Merge in brick order, so the mesh is the same no matter how the work was scheduled
+	MergeMeshBricks();
+}
+
+void AMarchingChunk::MarchBricks()
+{
+	ConfigureMesher();
+	MarchingCore::Mesher& ActiveMesher = GetActiveMesher();
+	if (!ActiveMesher.HasBrickSummary())
+	{
+		BuildBrickSummary();
+	}
+
+	// All air or all ground, nothing to march
+	ActiveMesher.ResetBricks();
+	if (!ActiveMesher.HasSurface())
+	{
+		return;
+	}
+
+	// Every layer of bricks is marched by one worker into the bricks' own buffers, so the workers never write to shared state
+	const float* Density = GetMarchedDensity();
+	ParallelFor(ActiveMesher.GetBricksPerAxis(), [&ActiveMesher, Density](int32 BrickZ)
+	{
+		ActiveMesher.MarchBrickLayer(Density, BrickZ);
+	}, bParallelMeshing ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+}
+
+void AMarchingChunk::MergeMeshBricks()
+{
+	// The mesher knows the exact size of the merged mesh and writes straight into the mesh buffers
+	const MarchingCore::Mesher& ActiveMesher = GetActiveMesher();
+	Verts.SetNumUninitialized(ActiveMesher.GetNumMergedVerts(), false);
+	Tris.SetNumUninitialized(ActiveMesher.GetNumMergedIndices(), false);
+	if (ActiveMesher.bGradientNormals)
+	{
+		Normals.SetNumUninitialized(Verts.Num(), false);
+	}
+	const int32 NumVerts = ActiveMesher.Merge(Verts.GetData(), Tris.GetData(), ActiveMesher.bGradientNormals ? Normals.GetData() : nullptr);
+	check(NumVerts == Verts.Num());
+
+	// Coarse meshes come out in units of the stride
+	if (LODStride > 1)
+	{
+		MarchingCore::DensityMip::ToSourcePositions(Verts.GetData(), Verts.Num(), GridMetrics.GetPointsPerChunk(), LODStride);
+	}
+}
+
+void AMarchingChunk::MarkPointsDirty(const FIntVector& MinPoint, const FIntVector& MaxPoint)
+{
+	Mesher.MarkPointsDirty(MinPoint.X, MinPoint.Y, MinPoint.Z, MaxPoint.X, MaxPoint.Y, MaxPoint.Z);
+}
+
+void AMarchingChunk::RemeshDirtyBricks()
+{
+	check(IsInGameThread());
+	check(!bIsGenerating);
+	ExpandDensity();
+
+	// Never meshed, there is no cached output to splice into. Coarse chunks keep no brick cache of the full resolution
+	// grid and are marched again as a whole.
+	if (!Mesher.HasBeenMarched() || LODStride > 1)
+	{
+		BuildBrickSummary();
+		Initialize();
+		return;
+	}
+
+	const std::vector<int> Dirty = Mesher.TakeDirtyBricks(Weights.GetData());
+	if (Dirty.empty())
+	{
+		return;
+	}
+
+	ConfigureMesher();
+	ParallelFor(static_cast<int32>(Dirty.size()), [this, &Dirty](int32 i)
+	{
+		MarchingCore::MarchScratch Scratch;
+		Mesher.MarchBrick(Weights.GetData(), Dirty[i], Scratch);
+	}, bParallelMeshing ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+
+	MergeMeshBricks();
+	GenerateNormalsAndUVs();
 	ConstructMesh();
 }
 
 void AMarchingChunk::Initialize()
 {
-	Triangles.Empty();
-	for (int x = 0; x < GridMetrics.PointsPerChunk; x++)
+	MarchCells();
+	GenerateNormalsAndUVs();
+	ConstructMesh();
+}
+
+void AMarchingChunk::ConstructMesh()
+{
+	if (ProceduralMesh || Region)
 	{
-		for (int y = 0; y < GridMetrics.PointsPerChunk; y++)
+		// The component stores double precision vertices, the packed buffers are widened here and nowhere else.
+		// Collision is cooked on its own component, the render mesh never cooks.
+		FProcMeshSection Section;
+		Section.bEnableCollision = false;
+		const bool bHasNormals = Normals.Num() == Verts.Num();
+		const bool bHasUVs = UVMap.Num() == Verts.Num();
+		Section.ProcVertexBuffer.Reserve(Verts.Num());
+		for (int32 i = 0; i < Verts.Num(); i++)
 		{
-			for (int z = 0; z < GridMetrics.PointsPerChunk; z++)
+			FProcMeshVertex& Vertex = Section.ProcVertexBuffer.AddDefaulted_GetRef();
+			Vertex.Position = FVector(Verts[i]);
+			if (bHasNormals)
 			{
-				March(FVector(x,y,z));
+				const MarchingCore::Vec3 Normal = Normals[i].Unpack();
+				Vertex.Normal = FVector(Normal.X, Normal.Y, Normal.Z);
 			}
+			if (bHasUVs)
+			{
+				Vertex.UV0 = FVector2D(UVMap[i]);
+			}
+			Section.SectionLocalBox += Vertex.Position;
+		}
+
+		Section.ProcIndexBuffer.SetNumUninitialized(Tris.Num());
+		for (int32 i = 0; i < Tris.Num(); i++)
+		{
+			Section.ProcIndexBuffer[i] = static_cast<uint32>(Tris[i]);
 		}
+
+		if (Region)
+		{
+			Region->SetChunkSection(GetChunkCoord(), Section, Material);
+		}
+		else
+		{
+			ProceduralMesh->SetProcMeshSection(0, Section);
+			ProceduralMesh->SetMaterial(0, Material);
+		}
+	}
+
+	// Managed chunks only flag their collision, UChunkCollisionSubsystem cooks it once when something is close enough
+	if (bCollisionManaged)
+	{
+		bCollisionStale = bHasCollision;
+	}
+	else
+	{
+		CookCollision();
 	}
-	GenerateMeshData(Triangles);
 }
 
-void AMarchingChunk::ConstructMesh()
+void AMarchingChunk::SetCollisionManaged(bool bManaged)
 {
-	if (ProceduralMesh)
+	bCollisionManaged = bManaged;
+	bCollisionStale = bHasCollision;
+}
+
+void AMarchingChunk::CookCollision(int DecimationCellSize)
+{
+	if (!CollisionMesh)
 	{
-		ProceduralMesh->ClearAllMeshSections();
-	
-		ProceduralMesh->CreateMeshSection(0,
-		Verts,
-		Tris,
-		Normals,
-		UVMap,
-		TArray<FColor>(),
-		TArray<FProcMeshTangent>(),
-		true);
+		return;
+	}
+
+	const TArray<FVector3f>* CollisionVerts = &Verts;
+	const TArray<int32>* CollisionTris = &Tris;
+	TArray<FVector3f> DecimatedVerts;
+	TArray<int32> DecimatedTris;
+	if (DecimationCellSize > 1)
+	{
+		DecimatedVerts.SetNumUninitialized(Verts.Num());
+		DecimatedTris.SetNumUninitialized(Tris.Num());
+		int32 NumIndices = 0;
+		const int32 NumVerts = MarchingCore::DecimateByClustering(Verts.GetData(), Verts.Num(), Tris.GetData(), Tris.Num(),
+			static_cast<float>(DecimationCellSize), DecimatedVerts.GetData(), DecimatedTris.GetData(), NumIndices);
+		DecimatedVerts.SetNum(NumVerts, false);
+		DecimatedTris.SetNum(NumIndices, false);
+		CollisionVerts = &DecimatedVerts;
+		CollisionTris = &DecimatedTris;
 	}
+
+	FProcMeshSection Section;
+	Section.bSectionVisible = false;
+	Section.bEnableCollision = true;
+	Section.ProcVertexBuffer.Reserve(CollisionVerts->Num());
+	for (const FVector3f& Vert : *CollisionVerts)
+	{
+		FProcMeshVertex& Vertex = Section.ProcVertexBuffer.AddDefaulted_GetRef();
+		Vertex.Position = FVector(Vert);
+		Section.SectionLocalBox += Vertex.Position;
+	}
+	Section.ProcIndexBuffer.SetNumUninitialized(CollisionTris->Num());
+	for (int32 i = 0; i < CollisionTris->Num(); i++)
+	{
+		Section.ProcIndexBuffer[i] = static_cast<uint32>((*CollisionTris)[i]);
+	}
+
+	// Async cooking keeps the previous body until the new one is ready
+	CollisionMesh->SetProcMeshSection(0, Section);
+	bHasCollision = true;
+	bCollisionStale = false;
+}
+
+void AMarchingChunk::ClearCollision()
+{
+	if (CollisionMesh && bHasCollision)
+	{
+		CollisionMesh->ClearAllMeshSections();
+	}
+	bHasCollision = false;
+	bCollisionStale = false;
+}
+
+FBox AMarchingChunk::GetWorldBounds() const
+{
+	const float Size = (GridMetrics.GetPointsPerChunk() - 1) * GridMetrics.GetDistance();
+	const FVector Origin = GetActorLocation();
+	return FBox(Origin, Origin + FVector(Size));
 }
 
 void AMarchingChunk::DrawDebugBoxes()
@@ -214,13 +776,13 @@ void AMarchingChunk::DrawDebugBoxes()
 	if (Weights.Num() == 0) {
 		return;
 	}
-	for (int x = 0; x < GridMetrics.PointsPerChunk; x++)
+	for (int x = 0; x < GridMetrics.GetPointsPerChunk(); x++)
 	{
-		for (int y = 0; y < GridMetrics.PointsPerChunk; y++)
+		for (int y = 0; y < GridMetrics.GetPointsPerChunk(); y++)
 		{
-			for (int z = 0; z < GridMetrics.PointsPerChunk; z++)
+			for (int z = 0; z < GridMetrics.GetPointsPerChunk(); z++)
 			{
-				int index = x + GridMetrics.PointsPerChunk * (y + GridMetrics.PointsPerChunk * z);
+				int index = GridMetrics.Index(x, y, z);
 				
 				UWorld* World = GetWorld(); // Get a reference to the current world
 				FColor Color = FLinearColor::LerpUsingHSV(FLinearColor::Black, FLinearColor::White, Weights[index]).ToFColor(true);
@@ -229,7 +791,7 @@ void AMarchingChunk::DrawDebugBoxes()
 				{
 					DrawDebugPoint(
 						World,
-						FVector(x,y,z) * GridMetrics.Distance,
+						FVector(x,y,z) * GridMetrics.GetDistance(),
 						2,
 						Color,
 						true
@@ -240,75 +802,34 @@ void AMarchingChunk::DrawDebugBoxes()
 	}
 }
 
-float AMarchingChunk::GenerateNoise(FVector pos)
+TArray<FVector2f> AMarchingChunk::GenerateUVMap()
 {
-	Noise = new FastNoiseLite();
-	
-	Noise->SetSeed(Seed);
-	
-	Noise->SetSeed(Seed);
-	Noise->SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-	Noise->SetFractalType(FastNoiseLite::FractalType_Ridged);
-	Noise->SetFrequency(Frequency);
-	Noise->SetFractalOctaves(Octaves);
-	
-	float Ground = -pos.Z + (GroundPercent * GridMetrics.PointsPerChunk);
-	
-	float NoiseValue = Noise->GetNoise(pos.X + InitialX * GridMetrics.PointsPerChunk - 1,
-									pos.Y + InitialY * GridMetrics.PointsPerChunk - 1,
-									pos.Z) * Amplitude;
-	
-	float HardFloorInfluence = FMath::Clamp((((HardFloorZ - pos.Z) * 3.0f)),0,1) * 40.0f; // Adjust the multiplier as needed
-	float Terracing = static_cast<int>(pos.Z) % TerraceHeight;
-	
-	float n = + Ground + NoiseValue + HardFloorInfluence + Terracing;
-	
-	return n;
-}
-
-TArray<FVector2D> AMarchingChunk::GenerateUVMap()
-{
-	TArray<FVector2D> UV;
+	TArray<FVector2f> UV;
 	float UVScale = 1.0f;
-	for (int x = 0; x < GridMetrics.PointsPerChunk; x++)
+	for (int x = 0; x < GridMetrics.GetPointsPerChunk(); x++)
 	{
-		for (int y = 0; y < GridMetrics.PointsPerChunk; y++)
+		for (int y = 0; y < GridMetrics.GetPointsPerChunk(); y++)
 		{
 			// Scale the x and y values to the range [0, 1]
-			float u = static_cast<float>(x) / (GridMetrics.PointsPerChunk - 1);
-			float v = static_cast<float>(y) / (GridMetrics.PointsPerChunk - 1);
+			float u = static_cast<float>(x) / (GridMetrics.GetPointsPerChunk() - 1);
+			float v = static_cast<float>(y) / (GridMetrics.GetPointsPerChunk() - 1);
 
-			UV.Add(FVector2D(u * UVScale, v * UVScale));
+			UV.Add(FVector2f(u * UVScale, v * UVScale));
 		}
 	}
 	return UV;
 }
 
-TArray<FVector> AMarchingChunk::CalcAverageNormals(TArray<FVector> verts, TArray<int32> tris)
+void AMarchingChunk::CalcAverageNormals(const TArray<FVector3f>& InVerts, const TArray<int32>& InTris, TArray<MarchingCore::PackedNormal>& OutNormals) const
 {
-	TArray<FVector> vertexNormals;
-	vertexNormals.Init(FVector::ZeroVector, verts.Num());
-	// Iterates through each triangle in the mesh
-	for (int32 i = 0; i < tris.Num(); i += 3)
-	{
-		int32 i0 = tris[i + 2];
-		int32 i1 = tris[i + 1];
-		int32 i2 = tris[i];
+	// Summed in floats, only the result is packed
+	TArray<FVector3f> Sums;
+	Sums.SetNumUninitialized(InVerts.Num());
+	MarchingCore::CalcAverageNormals(InVerts.GetData(), InVerts.Num(), InTris.GetData(), InTris.Num(), Sums.GetData());
 
-		FVector v1 = verts[i1] - verts[i0];
-		FVector v2 = verts[i2] - verts[i0];
-
-		FVector faceNormal = FVector::CrossProduct(v1, v2).GetSafeNormal();
-
-		// Accumulate the face normal to the corresponding vertices.
-		vertexNormals[i0] += faceNormal;
-		vertexNormals[i1] += faceNormal;
-		vertexNormals[i2] += faceNormal;
-	}
-	// Normalize the accumulated normals for each vertex to get the average normals.
-	for (FVector& normal : vertexNormals)
+	OutNormals.SetNumUninitialized(InVerts.Num(), false);
+	for (int32 i = 0; i < Sums.Num(); i++)
 	{
-		normal.Normalize();
+		OutNormals[i] = MarchingCore::PackedNormal(Sums[i].X, Sums[i].Y, Sums[i].Z);
 	}
-	return vertexNormals;
-}
\ No newline at end of file
+}
@@ -6,38 +6,139 @@
 #include "GameFramework/Actor.h"
 
 #include "Engine/StaticMesh.h"
-#include "Utility/FastNoiseLite.h"
 #include "Utility/GridMetrics.h"
+#include "TerrainGenerator.h"
+#include "Core/CompactDensity.h"
+#include "Core/EditJournal.h"
+#include "Core/Mesher.h"
 #include "Materials/MaterialInterface.h"
 
 #include "ProceduralMeshComponent.h"
 #include "Math/UnrealMathUtility.h"
+#include "Tasks/Task.h"
 
 #include "MarchingChunk.generated.h"
 
-struct FTriangle
+class AMarchingRegion;
+class FChunkMeshCache;
+
+// Surface extraction algorithm of a chunk, declared in the order of MarchingCore::MeshingMethod
+UENUM()
+enum class EMeshingMethod : uint8
 {
-	FVector a;
-	FVector b;
-	FVector c;
+	MarchingCubes,
+	// Fewer and better shaped triangles
+	SurfaceNets,
+	// Surface nets fitted to the density gradient, keeps sharp features
+	DualContouring
 };
 
 UCLASS()
 class MARCHINGCUBES_API AMarchingChunk : public AActor
 {
 	GENERATED_BODY()
+	// Times the private generation stages one by one
+	friend class UMarchingBenchCommandlet;
 public:	
 	AMarchingChunk();
 	virtual void Tick(float DeltaTime) override;
+	virtual void PostInitProperties() override;
+	virtual bool IsReadyForFinishDestroy() override;
 	
 	int IndexFromCoord(int x, int y, int z) const;
 
+	// Resizes the density grid and the mesher for another resolution, the chunk has to be regenerated afterwards
+	void SetResolution(EChunkResolution InResolution);
+
+	// Marches every Stride-th point of Weights instead of all of them, 1 for full resolution. Every border edge of the
+	// mesh on the side faces in InSkirtFaces (see MarchingCore::MeshSkirts::GetFaceBit) gets a quad hanging below it,
+	// hiding the cracks towards neighbours of another stride. The chunk has to be meshed again afterwards.
+	void SetLOD(int InLODStride, uint8 InSkirtFaces);
+	int GetLODStride() const { return LODStride; }
+	uint8 GetSkirtFaces() const { return SkirtFaces; }
+
+	// Recomputes face normals for vertices moved directly in Verts and rebuilds the section
 	void UpdateMesh();
 
 	void Initialize();
-	void March(FVector id);
+	// Runs PopulateTerrainMap, MarchCells and GenerateNormalsAndUVs on background tasks and commits the mesh on the game thread.
+	// Without bPopulateDensity the chunk keeps its Weights and is only meshed again, e.g. after its LOD changed.
+	void GenerateAsync(bool bPopulateDensity = true);
+	bool IsGenerating() const { return bIsGenerating; }
+
+	// Hides the chunk and drops its mesh section but keeps its component and buffers for the next coordinates
+	void ReleaseToPool();
+	void ReturnFromPool();
+	bool IsPooled() const { return bIsPooled; }
+	// Hands the chunk's mesh to the region's component instead of its own, nullptr renders it standalone again.
+	// Only drawing moves to the region, the chunk keeps its own collision.
+	void SetRegion(AMarchingRegion* InRegion);
+	AMarchingRegion* GetRegion() const { return Region; }
+
+	// Managed chunks leave cooking to UChunkCollisionSubsystem, the others cook collision with every mesh they build
+	void SetCollisionManaged(bool bManaged);
+	// Cooks collision for the current mesh asynchronously, from its vertices clustered into cells of DecimationCellSize
+	// grid points when that is above 1
+	void CookCollision(int DecimationCellSize = 1);
+	void ClearCollision();
+	bool HasCollision() const { return bHasCollision; }
+	// The mesh changed since its collision was cooked
+	bool IsCollisionStale() const { return bCollisionStale; }
+	FBox GetWorldBounds() const;
+	void MarchCells();
+	// Flags the bricks reading any of the grid points in [MinPoint, MaxPoint] for RemeshDirtyBricks
+	void MarkPointsDirty(const FIntVector& MinPoint, const FIntVector& MaxPoint);
+	// Re-marches only the dirty bricks, merges them with the cached output of the others and rebuilds the mesh section
+	void RemeshDirtyBricks();
 	void PopulateTerrainMap();
-	void GenerateMeshData(TArray<FTriangle> triangles);
+	// Copies the border plane shared with a face neighbour at Offset (a unit step along one axis) into Weights, so
+	// PopulateTerrainMap doesn't sample it again and both chunks start with the same values. Must be called before
+	// generation starts.
+	void CopySharedBorder(const AMarchingChunk& Neighbour, const FIntVector& Offset);
+	// The chunk sampled its whole density from the noise, kept it exact and no generation is writing to it
+	bool CanShareBorders() const { return bHasSampledDensity && !bDensityQuantized && !bSavedDensityLossy && !bIsGenerating && !bIsPooled; }
+
+	// Moves Weights into a compact copy and frees the floats, exact for chunks filled from the height shaping only and
+	// quantized with Quantization otherwise. Whatever reads Weights directly has to call ExpandDensity first.
+	void CompressDensity(MarchingCore::DensityEncoding Quantization);
+	// Decodes the compact copy back into Weights, does nothing when the chunk isn't compressed
+	void ExpandDensity();
+	bool IsDensityCompressed() const { return !CompactWeights.IsEmpty(); }
+	// Weights went through a lossy encoding since they were filled. The shared border planes no longer match the
+	// neighbours' then, so the chunk has to be filled again rather than meshed again.
+	bool IsDensityQuantized() const { return bDensityQuantized; }
+	// Weights hold brush strokes, loaded from the save or made since they were filled
+	bool HasDensityEdits() const { return bHasDensityEdits; }
+	// Density of a grid point, also while the chunk is compressed
+	float GetWeight(int Index) const { return IsDensityCompressed() ? CompactWeights.GetValue(Index) : Weights[Index]; }
+	SIZE_T GetDensityAllocatedSize() const { return Weights.GetAllocatedSize() + CompactWeights.GetAllocatedSize(); }
+
+	// Makes the next PopulateTerrainMap decode Blob, read by FChunkRegionStore, instead of sampling the noise
+	void SetSavedDensity(TArray<uint8>&& Blob);
+	// Makes the next PopulateTerrainMap apply Edits from FChunkEditJournal on top of the saved density or the noise.
+	// Shared borders are sampled again then, they may hold the same edits already.
+	void SetReplayedEdits(TArray<MarchingCore::BrushEdit>&& Edits);
+	// Adds a brush stroke to Weights and re-marches the bricks it touched, false when the stroke doesn't reach the chunk.
+	// A chunk that is generating applies the stroke when its mesh commits.
+	bool ApplyBrushEdit(const MarchingCore::BrushEdit& Edit);
+
+	// Lets generation take the mesh from Cache instead of the noise and the mesher and store what it builds there,
+	// nullptr for chunks that were edited. Must be set before generation starts, edits drop it.
+	void SetMeshCache(TSharedPtr<const FChunkMeshCache> InMeshCache);
+	// Reads the mesh of the current coordinates and stride from the cache, false when there is none. With bDeferDensity,
+	// Weights still belong to other coordinates and are only filled once something needs them, e.g. an edit.
+	bool LoadCachedMesh(bool bDeferDensity);
+	// Writes the current mesh to the cache, unless it was built from quantized density
+	void StoreCachedMesh() const;
+	// Hash of everything the mesh is built from besides the chunk coordinate: the terrain settings, the grid metrics,
+	// the marching properties and the stride
+	uint64 GetMeshSettingsHash() const;
+	// Must be set before generation starts, the generator is only read from then on
+	void SetTerrainGenerator(TSharedPtr<const FTerrainGenerator> InTerrainGenerator);
+	FTerrainSettings MakeTerrainSettings() const;
+	// Recomputes the density range of every brick, needed after Weights were changed outside PopulateTerrainMap
+	void BuildBrickSummary();
+	void GenerateNormalsAndUVs();
 	void ConstructMesh();
 	void ClearMesh();
 	void DrawDebugBoxes();
@@ -48,34 +149,111 @@ protected:
 	UMaterialInterface* Material;
 	
 private:
-	FVector InterpolateVertex(FVector edgeVertex1, float valueAtVertex1, FVector edgeVertex2, float valueAtVertex2) const;
+	// Copies the marching properties to the mesher before it runs
+	void ConfigureMesher();
+	// PopulateTerrainMap without the brick summary: fills Weights from the saved density or the noise and replays edits
+	void FillDensity();
+	// Makes Weights hold PointsPerChunk^3 points that are about to be overwritten, dropping a compact copy
+	void PrepareDensityForFill();
+	// The mesher and density of the current stride, the full resolution ones or the coarse copies
+	MarchingCore::Mesher& GetActiveMesher() { return LODStride > 1 ? LODMesher : Mesher; }
+	const float* GetMarchedDensity() const { return LODStride > 1 ? LODWeights.GetData() : Weights.GetData(); }
+	void AppendSkirts();
+	// The two halves of MarchCells: march every brick, then weld their output into Verts/Tris
+	void MarchBricks();
+	void MergeMeshBricks();
+	void CommitGeneratedMesh();
+	// Adds a stroke to Weights and flags the bricks it touched, without meshing
+	void AddBrushEditToDensity(const MarchingCore::BrushEdit& Edit);
+
+
+	TArray<FVector2f> GenerateUVMap();
+	// Face normals are only needed without gradient normals, the mesher produced those alongside the vertices
+	void GenerateNormals();
+	void CalcAverageNormals(const TArray<FVector3f>& InVerts, const TArray<int32>& InTris, TArray<MarchingCore::PackedNormal>& OutNormals) const;
 
+	// Last stage of the background generation, the chunk's buffers must not be touched until it completes
+	UE::Tasks::FTask GenerationTask;
+	bool bIsGenerating = false;
+	bool bIsPooled = false;
+	// Border planes of Weights copied from neighbours for the next PopulateTerrainMap, see TerrainDensity::GetBorderBit
+	uint8 SharedBorders = 0;
+	// Weights came from the noise rather than from the height shaping only, so neighbours may copy their borders
+	bool bHasSampledDensity = false;
+	// Holds the density instead of Weights while the chunk is compressed
+	MarchingCore::CompactDensity CompactWeights;
+	bool bDensityQuantized = false;
+	// Filled from a snapshot saved quantized by an older build, filling it again wouldn't make it exact
+	bool bSavedDensityLossy = false;
+	bool bHasDensityEdits = false;
+	// Compressed blob from FChunkRegionStore and the journal edits to replay on top of it for the next PopulateTerrainMap
+	TArray<uint8> SavedDensity;
+	TArray<MarchingCore::BrushEdit> ReplayedEdits;
+	// Strokes that reached the chunk while it was generating, applied by CommitGeneratedMesh
+	TArray<MarchingCore::BrushEdit> DeferredEdits;
+	TSharedPtr<const FChunkMeshCache> MeshCache;
+	// The mesh came from the cache, the mesher holds no brick output for it
+	bool bMeshFromCache = false;
+	// Weights were never filled for the current coordinates, BuildBrickSummary populates them first
+	bool bDensityPending = false;
 
-	float GenerateNoise(FVector pos);
-	TArray<FVector2D> GenerateUVMap();
-	TArray<FVector> CalcAverageNormals(TArray<FVector> verts, TArray<int32> tris);
+	UPROPERTY()
+	AMarchingRegion* Region = nullptr;
+
+	int LODStride = 1;
+	uint8 SkirtFaces = 0;
+	// Every LODStride-th point of Weights and its mesher, only used while the stride is above 1
+	TArray<float> LODWeights;
+	MarchingCore::Mesher LODMesher = MarchingCore::Mesher(2);
+
+	bool bCollisionManaged = false;
+	bool bHasCollision = false;
+	bool bCollisionStale = false;
 	
 public:
-	int InitialX, InitialY;
+	// Chunk coordinate, chunks are laid out in all three axes
+	int InitialX, InitialY, InitialZ;
+	FIntVector GetChunkCoord() const { return FIntVector(InitialX, InitialY, InitialZ); }
 	
-	TArray<FVector> Verts;
+	// Mesh buffers in single precision and chunk local grid units, only widened to FVector in ConstructMesh
+	TArray<FVector3f> Verts;
 	TArray<int32> Tris;
-	TArray<FVector> Normals;
-	TArray<FVector2D> UVMap;
+	TArray<MarchingCore::PackedNormal> Normals;
+	TArray<FVector2f> UVMap;
 
 	float time = 5.0;
 	
-	TArray<FTriangle> Triangles;
-	
 	TArray<float> Weights;
 	FGridMetrics GridMetrics;
 
+	// Engine independent marching of Weights, keeps the brick summary and the cached output of every brick
+	MarchingCore::Mesher Mesher = MarchingCore::Mesher(GridMetrics.GetPointsPerChunk());
+
 	UPROPERTY(EditAnywhere, Category=Mesh)
 	UProceduralMeshComponent* ProceduralMesh;
 
-	FastNoiseLite* Noise;
+	// Hidden, holds only the collision so cooking never has to follow the render mesh
+	UPROPERTY(VisibleAnywhere, Category=Mesh)
+	UProceduralMeshComponent* CollisionMesh;
+
+	// Shared by all chunks of the world, built from the noise properties below when none was set
+	TSharedPtr<const FTerrainGenerator> TerrainGenerator;
+	// Points per chunk axis, every resolution runs its own compile time specialisation of the mesher
+	UPROPERTY(EditDefaultsOnly, Category=Marching)
+	EChunkResolution Resolution = EChunkResolution::Points32;
 	UPROPERTY(EditAnywhere, Category=Marching)
 	float IsoLevel = 0.5f;
+	// When enabled, neighbouring triangles share the vertex on their common edge, producing an indexed mesh with smooth normals.
+	UPROPERTY(EditAnywhere, Category=Marching)
+	bool bShareVertices = true;
+	// Normals from the density gradient at every vertex instead of averaged face normals, smooth in one pass while marching
+	UPROPERTY(EditAnywhere, Category=Marching)
+	bool bGradientNormals = false;
+	UPROPERTY(EditAnywhere, Category=Marching)
+	EMeshingMethod MeshingMethod = EMeshingMethod::MarchingCubes;
+	// March layers of bricks on worker threads instead of on the calling thread
+	UPROPERTY(EditAnywhere, Category=Marching)
+	bool bParallelMeshing = true;
 	
 	// Seed for random variation (Default: 1337)
 	UPROPERTY(EditAnywhere, Category=Noise)
@@ -89,7 +267,7 @@ public:
 	// Octaves gives us details, when the noise is generated for a point, we will essentially regenerate it but at a smaller sample size and this for the amount of octaves.
 	UPROPERTY(EditAnywhere, Category=Noise)
 	int Octaves = 8;
-	// The ground percent just tells us where along the height of the chunk we want to be above ground. Note: must be from 0-1
+	// The ground percent just tells us where along the height of the chunks at Z = 0 we want to be above ground. Note: must be from 0-1
 	UPROPERTY(EditAnywhere, Category=Noise)
 	float GroundPercent = 0.2f;
 	UPROPERTY(EditAnywhere, Category=Noise)
@@ -97,7 +275,7 @@ public:
 	UPROPERTY(EditAnywhere, Category=Noise)
 	int TerraceHeight = 5;
 
-	int GetTriangleCount() const { return Triangles.Num(); }
+	int GetTriangleCount() const { return Tris.Num() / 3; }
 };
 
 
@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MarchingRegion.h"
+
+#include "MarchingChunk.h"
+
+AMarchingRegion::AMarchingRegion()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>("Root");
+}
+
+void AMarchingRegion::Setup(const FIntVector& InRegionCoord, int InRegionSize, const FGridMetrics& InGridMetrics)
+{
+	check(NumChunks == 0);
+	RegionCoord = InRegionCoord;
+	RegionSize = FMath::Max(InRegionSize, 1);
+	GridMetrics = InGridMetrics;
+	Chunks.SetNum(RegionSize * RegionSize * RegionSize);
+
+	// Like a chunk, the region is scaled by the point distance so its sections are in grid units
+	RootComponent->SetRelativeScale3D(FVector(GridMetrics.GetDistance()));
+
+	// All components sit at the region's origin, their bounds only cover the sections of their own block
+	ComponentsPerAxis = FMath::DivideAndRoundUp(RegionSize, ChunksPerComponent);
+	MeshComponents.SetNum(ComponentsPerAxis * ComponentsPerAxis * ComponentsPerAxis);
+	for (UProceduralMeshComponent*& MeshComponent : MeshComponents)
+	{
+		MeshComponent = NewObject<UProceduralMeshComponent>(this);
+		MeshComponent->SetupAttachment(RootComponent);
+		MeshComponent->RegisterComponent();
+	}
+}
+
+FIntVector AMarchingRegion::ChunkToRegionCoord(const FIntVector& ChunkCoord, int RegionSize)
+{
+	return FIntVector(FMath::FloorToInt(static_cast<float>(ChunkCoord.X) / RegionSize),
+		FMath::FloorToInt(static_cast<float>(ChunkCoord.Y) / RegionSize),
+		FMath::FloorToInt(static_cast<float>(ChunkCoord.Z) / RegionSize));
+}
+
+FIntVector AMarchingRegion::GetLocalCoord(const FIntVector& ChunkCoord) const
+{
+	const FIntVector Local = ChunkCoord - RegionCoord * RegionSize;
+	check(Local.X >= 0 && Local.X < RegionSize && Local.Y >= 0 && Local.Y < RegionSize && Local.Z >= 0 && Local.Z < RegionSize);
+	return Local;
+}
+
+int32 AMarchingRegion::GetChunkIndex(const FIntVector& ChunkCoord) const
+{
+	const FIntVector Local = GetLocalCoord(ChunkCoord);
+	return Local.X + RegionSize * (Local.Y + RegionSize * Local.Z);
+}
+
+UProceduralMeshComponent* AMarchingRegion::GetMeshComponent(const FIntVector& ChunkCoord, int32& OutSectionIndex) const
+{
+	const FIntVector Local = GetLocalCoord(ChunkCoord);
+	const FIntVector Block = Local / ChunksPerComponent;
+	const FIntVector InBlock = Local - Block * ChunksPerComponent;
+	OutSectionIndex = InBlock.X + ChunksPerComponent * (InBlock.Y + ChunksPerComponent * InBlock.Z);
+	return MeshComponents[Block.X + ComponentsPerAxis * (Block.Y + ComponentsPerAxis * Block.Z)];
+}
+
+void AMarchingRegion::AddChunk(const FIntVector& ChunkCoord, AMarchingChunk* Chunk)
+{
+	TWeakObjectPtr<AMarchingChunk>& Slot = Chunks[GetChunkIndex(ChunkCoord)];
+	if (!Slot.IsValid())
+	{
+		NumChunks++;
+	}
+	Slot = Chunk;
+}
+
+void AMarchingRegion::RemoveChunk(const FIntVector& ChunkCoord)
+{
+	const int32 ChunkIndex = GetChunkIndex(ChunkCoord);
+	if (Chunks[ChunkIndex].IsValid())
+	{
+		NumChunks--;
+	}
+	Chunks[ChunkIndex] = nullptr;
+
+	int32 SectionIndex;
+	UProceduralMeshComponent* MeshComponent = GetMeshComponent(ChunkCoord, SectionIndex);
+	if (SectionIndex < MeshComponent->GetNumSections())
+	{
+		MeshComponent->ClearMeshSection(SectionIndex);
+	}
+}
+
+void AMarchingRegion::SetChunkSection(const FIntVector& ChunkCoord, FProcMeshSection& Section, UMaterialInterface* Material)
+{
+	// Neighbouring chunks share their border points, so a chunk spans one point less than it has
+	const FVector Offset = FVector(GetLocalCoord(ChunkCoord)) * (GridMetrics.GetPointsPerChunk() - 1);
+	for (FProcMeshVertex& Vertex : Section.ProcVertexBuffer)
+	{
+		Vertex.Position += Offset;
+	}
+	Section.SectionLocalBox = Section.SectionLocalBox.ShiftBy(Offset);
+
+	// Only this chunk's block is marked dirty, the other components keep their scene proxies
+	int32 SectionIndex;
+	UProceduralMeshComponent* MeshComponent = GetMeshComponent(ChunkCoord, SectionIndex);
+	MeshComponent->SetProcMeshSection(SectionIndex, Section);
+	MeshComponent->SetMaterial(SectionIndex, Material);
+}
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+
+#include "Utility/GridMetrics.h"
+#include "ProceduralMeshComponent.h"
+
+#include "MarchingRegion.generated.h"
+
+class AMarchingChunk;
+
+// Renders a cubic block of RegionSize^3 chunks through a few mesh components, one section per chunk.
+// The chunks keep generating, editing and colliding on their own, they only hand their finished render sections to the
+// region. Each component draws a block of ChunksPerComponent^3 chunks, so a chunk that is meshed again only rebuilds the
+// scene proxy of its own block instead of every section in the region.
+UCLASS()
+class MARCHINGCUBES_API AMarchingRegion : public AActor
+{
+	GENERATED_BODY()
+public:
+	AMarchingRegion();
+
+	// Must be called right after spawning, before any chunk is added
+	void Setup(const FIntVector& InRegionCoord, int InRegionSize, const FGridMetrics& InGridMetrics);
+
+	// Region containing the chunk at ChunkCoord
+	static FIntVector ChunkToRegionCoord(const FIntVector& ChunkCoord, int RegionSize);
+
+	void AddChunk(const FIntVector& ChunkCoord, AMarchingChunk* Chunk);
+	// Drops the chunk and its section
+	void RemoveChunk(const FIntVector& ChunkCoord);
+	bool IsEmpty() const { return NumChunks == 0; }
+
+	// Replaces the chunk's section, its vertices are in the chunk's local grid units and moved into place here
+	void SetChunkSection(const FIntVector& ChunkCoord, FProcMeshSection& Section, UMaterialInterface* Material);
+
+	// Chunks along each side of the block one mesh component draws
+	static constexpr int ChunksPerComponent = 2;
+
+	UPROPERTY(VisibleAnywhere, Category=Mesh)
+	TArray<UProceduralMeshComponent*> MeshComponents;
+
+private:
+	// Chunk at ChunkCoord relative to the region's first chunk
+	FIntVector GetLocalCoord(const FIntVector& ChunkCoord) const;
+	int32 GetChunkIndex(const FIntVector& ChunkCoord) const;
+	// Component drawing the chunk at ChunkCoord and the chunk's section in it
+	UProceduralMeshComponent* GetMeshComponent(const FIntVector& ChunkCoord, int32& OutSectionIndex) const;
+
+	FIntVector RegionCoord = FIntVector::ZeroValue;
+	int RegionSize = 1;
+	FGridMetrics GridMetrics;
+
+	// Chunks along each side of the region divided into components, rounded up
+	int ComponentsPerAxis = 1;
+
+	// Indexed by GetChunkIndex
+	TArray<TWeakObjectPtr<AMarchingChunk>> Chunks;
+	int32 NumChunks = 0;
+};
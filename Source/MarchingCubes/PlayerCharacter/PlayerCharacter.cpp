@@ -9,6 +9,7 @@
 #include "GameFramework/PawnMovementComponent.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "Kismet/GameplayStatics.h"
+#include "MarchingCubes/ChunkSpawner.h"
 #include "MarchingCubes/MarchingChunk.h"
 
 #include "MarchingCubes/Utility/GridMetrics.h"
@@ -184,45 +185,48 @@ void APlayerCharacter::LookUp(float Value)
 	AddControllerPitchInput(Value);
 }
 
+AMarchingChunk* APlayerCharacter::GetTracedChunk() const
+{
+	// Chunks collide on their own collision component, also when a region draws them
+	return Cast<AMarchingChunk>(TraceHitInfo.GetActor());
+}
+
 void APlayerCharacter::EditWeights(float terraform)
 {
-	if (TraceHitInfo.GetActor() && TraceHitInfo.GetActor()->IsA<AMarchingChunk>())
+	if (AMarchingChunk* Chunk = GetTracedChunk())
 	{
-		AMarchingChunk* Chunk = Cast<AMarchingChunk>(TraceHitInfo.GetActor());
-		if (Chunk)
+		// The chunk's transform is scaled by the point distance, so local positions are in grid points
+		const FVector HitPositionLocal = Chunk->GetTransform().InverseTransformPosition(TraceHitInfo.ImpactPoint);
+		const FIntVector ChunkCoord = Chunk->GetChunkCoord();
+
+		MarchingCore::BrushEdit Edit;
+		Edit.ChunkX = ChunkCoord.X;
+		Edit.ChunkY = ChunkCoord.Y;
+		Edit.ChunkZ = ChunkCoord.Z;
+		Edit.CenterX = HitPositionLocal.X;
+		Edit.CenterY = HitPositionLocal.Y;
+		Edit.CenterZ = HitPositionLocal.Z;
+		Edit.Radius = BrushSize;
+		Edit.Strength = terraform * TerraformStrength;
+
+		// Neighbouring chunks share their border points, so a brush near the border also edits the neighbours it reaches
+		// into. Each of them evaluates the brush in the traced chunk's grid, so shared points get the same value in both.
+		AChunkSpawner* Spawner = Cast<AChunkSpawner>(Chunk->GetOwner());
+		const int PointsPerChunk = Chunk->GridMetrics.GetPointsPerChunk();
+		MarchingCore::ForEachBrushChunk(Edit, PointsPerChunk, [Chunk, Spawner, &Edit, &ChunkCoord, PointsPerChunk](int X, int Y, int Z, const int*, const int*)
 		{
-			int ChunkSize = Chunk->GridMetrics.PointsPerChunk;
-			FVector HitPositionLocal = Chunk->GetTransform().InverseTransformPosition(TraceHitInfo.ImpactPoint);
-			// Calculate the influence area based on the brush size
-			float BrushRadiusSq = BrushSize * BrushSize;
-			float BrushRadiusSqInverse = 1.0f / BrushRadiusSq;
-
-			for (int x = 0; x < ChunkSize; x++)
+			const FIntVector Coord(X, Y, Z);
+			AMarchingChunk* Target = Coord == ChunkCoord ? Chunk : (Spawner ? Spawner->FindChunk(Coord) : nullptr);
+			if (Target && Target->GridMetrics.GetPointsPerChunk() == PointsPerChunk)
 			{
-				for (int y = 0; y < ChunkSize; y++)
-				{
-					for (int z = 0; z < ChunkSize; z++)
-					{
-						// Check whether we are inside of our grid
-						if (x >= ChunkSize - 1 || y >= ChunkSize - 1 || z >= ChunkSize - 1)
-						{
-							return;
-						}
-						// Calculate influence based on distance
-						float DistSq = (FVector(x, y, z) * Chunk->GridMetrics.Distance - HitPositionLocal).SizeSquared();
-						float Influence = FMath::Clamp(1.0f - (DistSq * BrushRadiusSqInverse), 0.0f, 1.0f);
-
-						if (DistSq < BrushRadiusSq)
-						{
-							// Modify the weight value instead of directly modifying the vertices
-							Chunk->Weights[Chunk->IndexFromCoord(x, y, z)] += terraform * Influence * TerraformStrength;
-						}
-					}
-				}
+				Target->ApplyBrushEdit(Edit);
 			}
+		});
 
-			// Update the procedural mesh with the modified weights
-			Chunk->UpdateMesh();
+		// Chunks that aren't loaded get the stroke from the journal when they are
+		if (Spawner)
+		{
+			Spawner->RecordEdit(Edit);
 		}
 	}
 }
@@ -230,11 +234,9 @@ void APlayerCharacter::EditWeights(float terraform)
 void APlayerCharacter::DeformMesh(float terraform)
 {
 	// Check if the hit result has a valid actor and if it's the terrain you want to deform
-	if (TraceHitInfo.GetActor() && TraceHitInfo.GetActor()->IsA<AMarchingChunk>())
+	if (AMarchingChunk* Chunk = GetTracedChunk())
 	{
-		// Cast the hit actor to the terrain type (AMarchingChunk)
-		AMarchingChunk* Chunk = Cast<AMarchingChunk>(TraceHitInfo.GetActor());
-		if (Chunk)
+		if (!Chunk->IsGenerating())
 		{
 			if(GEngine)
 				GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Yellow, FString::Printf(TEXT("Seed: %i\n"), Chunk->Seed));			
@@ -248,7 +250,7 @@ void APlayerCharacter::DeformMesh(float terraform)
 			// Perform terrain deformation within the influence area
 			for (int32 i = 0; i < Chunk->Verts.Num(); i++)
 			{
-				FVector VertexLocal = Chunk->Verts[i];
+				FVector VertexLocal = FVector(Chunk->Verts[i]);
 				float DistSq = (VertexLocal - HitPositionLocal).SizeSquared();
 				if (DistSq < BrushRadiusSq)
 				{
@@ -260,7 +262,7 @@ void APlayerCharacter::DeformMesh(float terraform)
 					VertexLocal += n;
 					
 					// Update the vertex in the chunk's vertices array
-					Chunk->Verts[i] = VertexLocal;
+					Chunk->Verts[i] = FVector3f(VertexLocal);
 				}
 			}
 
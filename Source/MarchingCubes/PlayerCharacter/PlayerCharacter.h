@@ -37,6 +37,8 @@ protected:
 
 	void ApplyThrust();
 	void TraceUnderCrosshairs(FHitResult& TraceHitResult);
+	// Chunk under the last trace hit
+	AMarchingChunk* GetTracedChunk() const;
 private:
 	FHitResult TraceHitInfo;
 	
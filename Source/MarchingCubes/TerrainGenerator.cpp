@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainGenerator.h"
+
+FTerrainGenerator::FTerrainGenerator(const FTerrainSettings& InSettings, const FGridMetrics& InGridMetrics)
+	: Density(InSettings, InGridMetrics.GetPointsPerChunk())
+{
+}
+
+bool FTerrainGenerator::FillChunkDensity(float* OutWeights, const FIntVector& ChunkCoord, float IsoLevel, uint8 SharedBorders) const
+{
+	if (!Density.GetChunkBounds(ChunkCoord.Z).Crosses(IsoLevel))
+	{
+		Density.FillChunkShape(OutWeights, ChunkCoord.Z);
+		return false;
+	}
+	Density.FillChunk(OutWeights, ChunkCoord.X, ChunkCoord.Y, ChunkCoord.Z, SharedBorders);
+	return true;
+}
+
+float FTerrainGenerator::GetDensity(const FIntVector& ChunkCoord, FVector Point) const
+{
+	return Density.GetDensity(ChunkCoord.X, ChunkCoord.Y, ChunkCoord.Z, Point.X, Point.Y, Point.Z);
+}
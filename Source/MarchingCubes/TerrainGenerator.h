@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/TerrainDensity.h"
+#include "Utility/GridMetrics.h"
+
+// Parameters the terrain density is built from
+using FTerrainSettings = MarchingCore::TerrainSettings;
+
+// Turns chunk coordinates into density values.
+// Configured once on construction and immutable afterwards, so a single instance can be shared by every chunk of a world
+// and sampled from any thread.
+class MARCHINGCUBES_API FTerrainGenerator
+{
+public:
+	FTerrainGenerator(const FTerrainSettings& InSettings, const FGridMetrics& InGridMetrics);
+
+	// Fills the PointsPerChunk^3 density grid of a chunk, indexed x + N * (y + N * z), except for the border planes
+	// flagged in SharedBorders, which were copied from neighbours. Chunks that lie entirely above or below the surface at
+	// IsoLevel skip the noise, fill every point with the height shaping only and return false.
+	bool FillChunkDensity(float* OutWeights, const FIntVector& ChunkCoord, float IsoLevel, uint8 SharedBorders = 0) const;
+
+	// Density of a single point of a chunk
+	float GetDensity(const FIntVector& ChunkCoord, FVector Point) const;
+
+	const FTerrainSettings& GetSettings() const { return Density.GetSettings(); }
+
+private:
+	const MarchingCore::TerrainDensity Density;
+};
@@ -0,0 +1,419 @@
+#pragma once
+
+// Batched grid evaluation on top of FastNoiseLite.
+// Fills a whole block of 3D noise in one call, using SSE2/AVX2 kernels for OpenSimplex2 with no/FBm/ridged fractal,
+// and falls back to FastNoiseLite::GetNoise for every other configuration or when no SIMD instruction set is available.
+// The kernels evaluate the same float expressions as the scalar code, results match GetNoise called with float coordinates.
+
+#include <cstdint>
+
+#include "FastNoiseLite.h"
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define FASTNOISEGRID_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define FASTNOISEGRID_SSE2 1
+#endif
+
+class FastNoiseGrid
+{
+public:
+	enum SimdLevel
+	{
+		SimdLevel_Scalar,
+		SimdLevel_SSE2,
+		SimdLevel_AVX2
+	};
+
+	// Best instruction set this translation unit was compiled for
+	static SimdLevel GetSupportedSimdLevel()
+	{
+#if FASTNOISEGRID_AVX2
+		return SimdLevel_AVX2;
+#elif FASTNOISEGRID_SSE2
+		return SimdLevel_SSE2;
+#else
+		return SimdLevel_Scalar;
+#endif
+	}
+
+	// Whether the settings of Noise can be evaluated by the SIMD kernels
+	static bool HasSimdKernel(const FastNoiseLite& Noise)
+	{
+		return Noise.mNoiseType == FastNoiseLite::NoiseType_OpenSimplex2
+			&& Noise.mTransformType3D == FastNoiseLite::TransformType3D_DefaultOpenSimplex2
+			&& (Noise.mFractalType == FastNoiseLite::FractalType_None
+				|| Noise.mFractalType == FastNoiseLite::FractalType_FBm
+				|| Noise.mFractalType == FastNoiseLite::FractalType_Ridged);
+	}
+
+	// Writes GetNoise(OriginX + x * Step, OriginY + y * Step, OriginZ + z * Step) to Out[x + SizeX * (y + SizeY * z)]
+	static void GenUniformGrid3D(const FastNoiseLite& Noise, float* Out,
+		float OriginX, float OriginY, float OriginZ, int SizeX, int SizeY, int SizeZ, float Step = 1.0f,
+		SimdLevel MaxLevel = SimdLevel_AVX2)
+	{
+		SimdLevel Level = GetSupportedSimdLevel();
+		if (Level > MaxLevel)
+		{
+			Level = MaxLevel;
+		}
+		if (!HasSimdKernel(Noise))
+		{
+			Level = SimdLevel_Scalar;
+		}
+
+		for (int z = 0; z < SizeZ; z++)
+		{
+			for (int y = 0; y < SizeY; y++)
+			{
+				float* Row = Out + SizeX * (y + SizeY * z);
+				const float PosY = OriginY + y * Step;
+				const float PosZ = OriginZ + z * Step;
+
+				int x = 0;
+#if FASTNOISEGRID_AVX2
+				if (Level == SimdLevel_AVX2)
+				{
+					x = GenRow<FAvx2>(Noise, Row, OriginX, Step, PosY, PosZ, x, SizeX);
+				}
+#endif
+#if FASTNOISEGRID_SSE2
+				if (Level >= SimdLevel_SSE2)
+				{
+					x = GenRow<FSse2>(Noise, Row, OriginX, Step, PosY, PosZ, x, SizeX);
+				}
+#endif
+				// Scalar fallback and the tail of rows that are not a multiple of the SIMD width
+				for (; x < SizeX; x++)
+				{
+					Row[x] = Noise.GetNoise(OriginX + x * Step, PosY, PosZ);
+				}
+			}
+		}
+	}
+
+private:
+#if FASTNOISEGRID_SSE2
+	struct FSse2
+	{
+		static constexpr int Width = 4;
+		using F = __m128;
+		using I = __m128i;
+
+		static F Set(float v) { return _mm_set1_ps(v); }
+		static I SetI(int v) { return _mm_set1_epi32(v); }
+		static F Ramp(float Origin, float Step, int First)
+		{
+			return _mm_setr_ps(Origin + First * Step, Origin + (First + 1) * Step, Origin + (First + 2) * Step, Origin + (First + 3) * Step);
+		}
+		static void Store(float* p, F v) { _mm_storeu_ps(p, v); }
+
+		static F Add(F a, F b) { return _mm_add_ps(a, b); }
+		static F Sub(F a, F b) { return _mm_sub_ps(a, b); }
+		static F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+		static F Abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+		static F Gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+		static F Ge(F a, F b) { return _mm_cmpge_ps(a, b); }
+		static F And(F a, F b) { return _mm_and_ps(a, b); }
+		static F AndNot(F a, F b) { return _mm_andnot_ps(a, b); }
+		static F Or(F a, F b) { return _mm_or_ps(a, b); }
+		static F AllTrue() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+		static F Select(F Mask, F a, F b) { return _mm_or_ps(_mm_and_ps(Mask, a), _mm_andnot_ps(Mask, b)); }
+		static I SelectI(F Mask, I a, I b)
+		{
+			const I m = _mm_castps_si128(Mask);
+			return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+		}
+
+		static I AddI(I a, I b) { return _mm_add_epi32(a, b); }
+		static I SubI(I a, I b) { return _mm_sub_epi32(a, b); }
+		static I XorI(I a, I b) { return _mm_xor_si128(a, b); }
+		static I AndI(I a, I b) { return _mm_and_si128(a, b); }
+		static I OrI(I a, I b) { return _mm_or_si128(a, b); }
+		static I SraI(I a, int Count) { return _mm_srai_epi32(a, Count); }
+		static I MulI(I a, I b)
+		{
+			// SSE2 has no 32 bit low multiply, multiply the even and odd lanes separately
+			const I Even = _mm_mul_epu32(a, b);
+			const I Odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+			return _mm_unpacklo_epi32(_mm_shuffle_epi32(Even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(Odd, _MM_SHUFFLE(0, 0, 2, 0)));
+		}
+		static I IsNegativeI(I a) { return _mm_srai_epi32(a, 31); }
+
+		static I Truncate(F a) { return _mm_cvttps_epi32(a); }
+		static F ToFloat(I a) { return _mm_cvtepi32_ps(a); }
+
+		static F Gather(const float* Table, I Index)
+		{
+			alignas(16) int32_t Lanes[4];
+			_mm_store_si128(reinterpret_cast<I*>(Lanes), Index);
+			return _mm_setr_ps(Table[Lanes[0]], Table[Lanes[1]], Table[Lanes[2]], Table[Lanes[3]]);
+		}
+	};
+#endif
+
+#if FASTNOISEGRID_AVX2
+	struct FAvx2
+	{
+		static constexpr int Width = 8;
+		using F = __m256;
+		using I = __m256i;
+
+		static F Set(float v) { return _mm256_set1_ps(v); }
+		static I SetI(int v) { return _mm256_set1_epi32(v); }
+		static F Ramp(float Origin, float Step, int First)
+		{
+			return _mm256_setr_ps(Origin + First * Step, Origin + (First + 1) * Step, Origin + (First + 2) * Step, Origin + (First + 3) * Step,
+				Origin + (First + 4) * Step, Origin + (First + 5) * Step, Origin + (First + 6) * Step, Origin + (First + 7) * Step);
+		}
+		static void Store(float* p, F v) { _mm256_storeu_ps(p, v); }
+
+		static F Add(F a, F b) { return _mm256_add_ps(a, b); }
+		static F Sub(F a, F b) { return _mm256_sub_ps(a, b); }
+		static F Mul(F a, F b) { return _mm256_mul_ps(a, b); }
+		static F Abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+		static F Gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		static F Ge(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static F And(F a, F b) { return _mm256_and_ps(a, b); }
+		static F AndNot(F a, F b) { return _mm256_andnot_ps(a, b); }
+		static F Or(F a, F b) { return _mm256_or_ps(a, b); }
+		static F AllTrue() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+		static F Select(F Mask, F a, F b) { return _mm256_blendv_ps(b, a, Mask); }
+		static I SelectI(F Mask, I a, I b) { return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), Mask)); }
+
+		static I AddI(I a, I b) { return _mm256_add_epi32(a, b); }
+		static I SubI(I a, I b) { return _mm256_sub_epi32(a, b); }
+		static I XorI(I a, I b) { return _mm256_xor_si256(a, b); }
+		static I AndI(I a, I b) { return _mm256_and_si256(a, b); }
+		static I OrI(I a, I b) { return _mm256_or_si256(a, b); }
+		static I SraI(I a, int Count) { return _mm256_srai_epi32(a, Count); }
+		static I MulI(I a, I b) { return _mm256_mullo_epi32(a, b); }
+		static I IsNegativeI(I a) { return _mm256_srai_epi32(a, 31); }
+
+		static I Truncate(F a) { return _mm256_cvttps_epi32(a); }
+		static F ToFloat(I a) { return _mm256_cvtepi32_ps(a); }
+
+		static F Gather(const float* Table, I Index) { return _mm256_i32gather_ps(Table, Index, 4); }
+	};
+#endif
+
+	// Evaluates the SIMD blocks of a row from Begin on, returns the index of the first point not written
+	template <typename S>
+	static int GenRow(const FastNoiseLite& Noise, float* Out, float OriginX, float Step, float PosY, float PosZ, int Begin, int End)
+	{
+		using F = typename S::F;
+
+		const auto GenVector = [&Noise, Out, OriginX, Step, PosY, PosZ](int x)
+		{
+			F X = S::Ramp(OriginX, Step, x);
+			F Y = S::Set(PosY);
+			F Z = S::Set(PosZ);
+
+			// Same as FastNoiseLite::TransformNoiseCoordinate for TransformType3D_DefaultOpenSimplex2
+			const F Frequency = S::Set(Noise.mFrequency);
+			X = S::Mul(X, Frequency);
+			Y = S::Mul(Y, Frequency);
+			Z = S::Mul(Z, Frequency);
+
+			const F R = S::Mul(S::Add(S::Add(X, Y), Z), S::Set(2.0f / 3.0f));
+			X = S::Sub(R, X);
+			Y = S::Sub(R, Y);
+			Z = S::Sub(R, Z);
+
+			S::Store(Out + x, GenFractal<S>(Noise, X, Y, Z));
+		};
+
+		int x = Begin;
+		for (; x + S::Width <= End; x += S::Width)
+		{
+			GenVector(x);
+		}
+		// Rows that are not a multiple of the width end with one vector overlapping the previous one, the lanes give
+		// the same results as the scalar path so the overlap is simply written twice
+		if (x < End && End - Begin >= S::Width)
+		{
+			GenVector(End - S::Width);
+			x = End;
+		}
+		return x;
+	}
+
+	template <typename S>
+	static typename S::F GenFractal(const FastNoiseLite& Noise, typename S::F X, typename S::F Y, typename S::F Z)
+	{
+		using F = typename S::F;
+
+		if (Noise.mFractalType == FastNoiseLite::FractalType_None)
+		{
+			return SingleOpenSimplex2<S>(Noise.mSeed, X, Y, Z);
+		}
+
+		const bool bRidged = Noise.mFractalType == FastNoiseLite::FractalType_Ridged;
+		const F One = S::Set(1.0f);
+		const F Half = S::Set(0.5f);
+		const F WeightedStrength = S::Set(Noise.mWeightedStrength);
+		const F Lacunarity = S::Set(Noise.mLacunarity);
+		const F Gain = S::Set(Noise.mGain);
+
+		int Seed = Noise.mSeed;
+		F Sum = S::Set(0.0f);
+		F Amp = S::Set(Noise.mFractalBounding);
+
+		for (int i = 0; i < Noise.mOctaves; i++)
+		{
+			F Value = SingleOpenSimplex2<S>(Seed++, X, Y, Z);
+			F Weight;
+			if (bRidged)
+			{
+				// GenFractalRidged
+				Value = S::Abs(Value);
+				Sum = S::Add(Sum, S::Mul(S::Add(S::Mul(Value, S::Set(-2.0f)), One), Amp));
+				Weight = S::Sub(One, Value);
+			}
+			else
+			{
+				// GenFractalFBm
+				Sum = S::Add(Sum, S::Mul(Value, Amp));
+				Weight = S::Mul(S::Add(Value, One), Half);
+			}
+			// Amp *= Lerp(1, Weight, WeightedStrength)
+			Amp = S::Mul(Amp, S::Add(One, S::Mul(WeightedStrength, S::Sub(Weight, One))));
+
+			X = S::Mul(X, Lacunarity);
+			Y = S::Mul(Y, Lacunarity);
+			Z = S::Mul(Z, Lacunarity);
+			Amp = S::Mul(Amp, Gain);
+		}
+		return Sum;
+	}
+
+	// FastNoiseLite::FastRound, rounds half away from zero
+	template <typename S>
+	static typename S::I Round(typename S::F v)
+	{
+		const typename S::F Bias = S::Select(S::Ge(v, S::Set(0.0f)), S::Set(0.5f), S::Set(-0.5f));
+		return S::Truncate(S::Add(v, Bias));
+	}
+
+	template <typename S>
+	static typename S::F GradCoord(typename S::I Seed, typename S::I XPrimed, typename S::I YPrimed, typename S::I ZPrimed,
+		typename S::F xd, typename S::F yd, typename S::F zd)
+	{
+		using I = typename S::I;
+
+		I Hash = S::XorI(S::XorI(Seed, XPrimed), S::XorI(YPrimed, ZPrimed));
+		Hash = S::MulI(Hash, S::SetI(0x27d4eb2d));
+		Hash = S::XorI(Hash, S::SraI(Hash, 15));
+		Hash = S::AndI(Hash, S::SetI(63 << 2));
+
+		const float* Gradients = FastNoiseLite::Lookup<float>::Gradients3D;
+		const typename S::F xg = S::Gather(Gradients, Hash);
+		const typename S::F yg = S::Gather(Gradients, S::OrI(Hash, S::SetI(1)));
+		const typename S::F zg = S::Gather(Gradients, S::OrI(Hash, S::SetI(2)));
+
+		return S::Add(S::Add(S::Mul(xd, xg), S::Mul(yd, yg)), S::Mul(zd, zg));
+	}
+
+	// Branch free version of FastNoiseLite::SingleOpenSimplex2 (3D), every branch is evaluated and blended per lane
+	template <typename S>
+	static typename S::F SingleOpenSimplex2(int SeedValue, typename S::F x, typename S::F y, typename S::F z)
+	{
+		using F = typename S::F;
+		using I = typename S::I;
+
+		const F Zero = S::Set(0.0f);
+		const F Half = S::Set(0.5f);
+		const I PrimeX = S::SetI(FastNoiseLite::PrimeX);
+		const I PrimeY = S::SetI(FastNoiseLite::PrimeY);
+		const I PrimeZ = S::SetI(FastNoiseLite::PrimeZ);
+
+		I i = Round<S>(x);
+		I j = Round<S>(y);
+		I k = Round<S>(z);
+		F x0 = S::Sub(x, S::ToFloat(i));
+		F y0 = S::Sub(y, S::ToFloat(j));
+		F z0 = S::Sub(z, S::ToFloat(k));
+
+		// (int)(-1.0f - x0) | 1
+		I xNSign = S::OrI(S::Truncate(S::Sub(S::Set(-1.0f), x0)), S::SetI(1));
+		I yNSign = S::OrI(S::Truncate(S::Sub(S::Set(-1.0f), y0)), S::SetI(1));
+		I zNSign = S::OrI(S::Truncate(S::Sub(S::Set(-1.0f), z0)), S::SetI(1));
+		F xSign = S::ToFloat(xNSign);
+		F ySign = S::ToFloat(yNSign);
+		F zSign = S::ToFloat(zNSign);
+
+		F ax0 = S::Mul(xSign, S::Sub(Zero, x0));
+		F ay0 = S::Mul(ySign, S::Sub(Zero, y0));
+		F az0 = S::Mul(zSign, S::Sub(Zero, z0));
+
+		i = S::MulI(i, PrimeX);
+		j = S::MulI(j, PrimeY);
+		k = S::MulI(k, PrimeZ);
+
+		F Value = Zero;
+		F a = S::Sub(S::Sub(S::Set(0.6f), S::Mul(x0, x0)), S::Add(S::Mul(y0, y0), S::Mul(z0, z0)));
+		I Seed = S::SetI(SeedValue);
+
+		for (int l = 0; ; l++)
+		{
+			F a2 = S::Mul(a, a);
+			F Contribution = S::Mul(S::Mul(a2, a2), GradCoord<S>(Seed, i, j, k, x0, y0, z0));
+			Value = S::Add(Value, S::And(S::Gt(a, Zero), Contribution));
+
+			// Step towards the closest of the three neighbouring lattice points
+			const F bX = S::And(S::Ge(ax0, ay0), S::Ge(ax0, az0));
+			const F bY = S::AndNot(bX, S::And(S::Gt(ay0, ax0), S::Ge(ay0, az0)));
+			const F bZ = S::AndNot(S::Or(bX, bY), S::AllTrue());
+
+			F x1 = S::Select(bX, S::Add(x0, xSign), x0);
+			F y1 = S::Select(bY, S::Add(y0, ySign), y0);
+			F z1 = S::Select(bZ, S::Add(z0, zSign), z0);
+
+			F b = S::Add(a, S::Set(1.0f));
+			b = S::Select(bX, S::Sub(b, S::Mul(S::Mul(xSign, S::Set(2.0f)), x1)), b);
+			b = S::Select(bY, S::Sub(b, S::Mul(S::Mul(ySign, S::Set(2.0f)), y1)), b);
+			b = S::Select(bZ, S::Sub(b, S::Mul(S::Mul(zSign, S::Set(2.0f)), z1)), b);
+
+			const I i1 = S::SelectI(bX, S::SubI(i, S::MulI(xNSign, PrimeX)), i);
+			const I j1 = S::SelectI(bY, S::SubI(j, S::MulI(yNSign, PrimeY)), j);
+			const I k1 = S::SelectI(bZ, S::SubI(k, S::MulI(zNSign, PrimeZ)), k);
+
+			F b2 = S::Mul(b, b);
+			Contribution = S::Mul(S::Mul(b2, b2), GradCoord<S>(Seed, i1, j1, k1, x1, y1, z1));
+			Value = S::Add(Value, S::And(S::Gt(b, Zero), Contribution));
+
+			if (l == 1) break;
+
+			ax0 = S::Sub(Half, ax0);
+			ay0 = S::Sub(Half, ay0);
+			az0 = S::Sub(Half, az0);
+
+			x0 = S::Mul(xSign, ax0);
+			y0 = S::Mul(ySign, ay0);
+			z0 = S::Mul(zSign, az0);
+
+			a = S::Add(a, S::Sub(S::Sub(S::Set(0.75f), ax0), S::Add(ay0, az0)));
+
+			// (xNSign >> 1) & PrimeX
+			i = S::AddI(i, S::AndI(S::IsNegativeI(xNSign), PrimeX));
+			j = S::AddI(j, S::AndI(S::IsNegativeI(yNSign), PrimeY));
+			k = S::AddI(k, S::AndI(S::IsNegativeI(zNSign), PrimeZ));
+
+			xNSign = S::SubI(S::SetI(0), xNSign);
+			yNSign = S::SubI(S::SetI(0), yNSign);
+			zNSign = S::SubI(S::SetI(0), zNSign);
+			xSign = S::Sub(Zero, xSign);
+			ySign = S::Sub(Zero, ySign);
+			zSign = S::Sub(Zero, zSign);
+
+			Seed = S::SetI(~SeedValue);
+		}
+
+		return S::Mul(Value, S::Set(32.69428253173828125f));
+	}
+};
@@ -54,6 +54,9 @@
 
 class FastNoiseLite
 {
+    // Batched grid evaluation (FastNoiseGrid.h) reads the settings and tables directly
+    friend class FastNoiseGrid;
+
 public:
     enum NoiseType
     {
@@ -1,7 +1,48 @@
 #pragma once
 
+#include "CoreMinimal.h"
+#include "Core/GridDims.h"
+#include "GridMetrics.generated.h"
+
+// Chunk resolutions the marching core has a compile time instantiation for
+UENUM()
+enum class EChunkResolution : uint8
+{
+	Points16 UMETA(DisplayName = "16 points"),
+	Points32 UMETA(DisplayName = "32 points"),
+	Points64 UMETA(DisplayName = "64 points")
+};
+
+// Grid dimensions of the resolution a chunk class picked, the core grid plus the spacing of its points in the world.
+// Read only once built, a chunk that changes its resolution is given a whole new one.
 struct FGridMetrics
 {
-	const int PointsPerChunk = 32; // Number of points in a chunk (density)
-	const float Distance = 100.f; // Distance between points
+	FGridMetrics() = default;
+
+	template<int InPointsPerChunk>
+	FGridMetrics(MarchingCore::StaticGrid<InPointsPerChunk>)
+		: Grid{ MarchingCore::StaticGrid<InPointsPerChunk>::PointsPerAxis }
+	{
+	}
+
+	explicit FGridMetrics(EChunkResolution Resolution)
+	{
+		switch (Resolution)
+		{
+		case EChunkResolution::Points16: *this = FGridMetrics(MarchingCore::StaticGrid<16>()); break;
+		case EChunkResolution::Points64: *this = FGridMetrics(MarchingCore::StaticGrid<64>()); break;
+		default: *this = FGridMetrics(MarchingCore::StaticGrid<32>()); break;
+		}
+	}
+
+	// Number of points in a chunk (density) along each axis
+	int GetPointsPerChunk() const { return Grid.PointsPerAxis; }
+	// Distance between points
+	float GetDistance() const { return Distance; }
+	int GetNumPoints() const { return Grid.PointsPerAxis * Grid.PointsPerAxis * Grid.PointsPerAxis; }
+	int Index(int X, int Y, int Z) const { return Grid.Index(X, Y, Z); }
+
+private:
+	MarchingCore::DynamicGrid Grid{ 32 };
+	float Distance = 100.f;
 };
@@ -0,0 +1,234 @@
+// Checks of the engine independent mesher, built by the root CMakeLists.txt and run by ctest.
+//
+// Every meshing method is run with and without shared vertices and gradient normals on a few densities, and the merged
+// mesh is checked against the sizes the mesher promised and for indices out of range. Indexed meshes must be closed
+// everywhere but on the chunk border, where they have to meet the mesh of the neighbouring chunk.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Core/Mesher.h"
+#include "Core/TerrainDensity.h"
+
+using namespace MarchingCore;
+
+namespace
+{
+	int NumFailures = 0;
+
+	void Check(bool bCondition, const std::string& Case, const char* What)
+	{
+		if (!bCondition)
+		{
+			std::fprintf(stderr, "FAILED %s: %s\n", Case.c_str(), What);
+			NumFailures++;
+		}
+	}
+
+	struct TestDensity
+	{
+		const char* Name;
+		std::vector<float> Values;
+		float IsoLevel;
+	};
+
+	// A ball around the chunk's center that pokes through all six faces, the density falls towards the air
+	TestDensity MakeBall(int N)
+	{
+		TestDensity Ball{ "Ball", std::vector<float>(static_cast<size_t>(N) * N * N), 0.0f };
+		const float Center = (N - 1) * 0.5f;
+		const float Radius = (N - 1) * 0.6f;
+		for (int z = 0; z < N; z++)
+		{
+			for (int y = 0; y < N; y++)
+			{
+				for (int x = 0; x < N; x++)
+				{
+					const float DX = x - Center, DY = y - Center, DZ = z - Center;
+					Ball.Values[x + N * (y + N * z)] = Radius - std::sqrt(DX * DX + DY * DY + DZ * DZ);
+				}
+			}
+		}
+		return Ball;
+	}
+
+	TestDensity MakeTerrain(int N, int ChunkX = 0)
+	{
+		TestDensity Terrain{ "Terrain", std::vector<float>(static_cast<size_t>(N) * N * N), 0.5f };
+		const TerrainDensity Generator(TerrainSettings(), N);
+		Generator.FillChunk(Terrain.Values.data(), ChunkX, 0, 0);
+		return Terrain;
+	}
+
+	struct TestMesh
+	{
+		std::vector<Vec3> Verts;
+		std::vector<int32_t> Tris;
+	};
+
+	std::string GetCaseName(const char* DensityName, int N, MeshingMethod Method, bool bShareVertices, bool bGradientNormals)
+	{
+		const char* MethodNames[] = { "MarchingCubes", "SurfaceNets", "DualContouring" };
+		return std::string(DensityName) + "/" + MethodNames[static_cast<int>(Method)]
+			+ (bShareVertices ? "/Shared" : "/Soup") + (bGradientNormals ? "/Gradient" : "") + "/" + std::to_string(N);
+	}
+
+	// Triangle edges used by a single triangle, as pairs of vertex indices
+	std::vector<std::pair<int32_t, int32_t>> GetOpenEdges(const TestMesh& Mesh)
+	{
+		std::map<std::pair<int32_t, int32_t>, int> EdgeUses;
+		for (size_t i = 0; i < Mesh.Tris.size(); i += 3)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				const int32_t From = Mesh.Tris[i + j];
+				const int32_t To = Mesh.Tris[i + (j + 1) % 3];
+				EdgeUses[std::minmax(From, To)]++;
+			}
+		}
+
+		std::vector<std::pair<int32_t, int32_t>> OpenEdges;
+		for (const auto& [Edge, Uses] : EdgeUses)
+		{
+			if (Uses == 1)
+			{
+				OpenEdges.push_back(Edge);
+			}
+		}
+		return OpenEdges;
+	}
+
+	TestMesh CheckMesh(const TestDensity& Density, int N, MeshingMethod Method, bool bShareVertices, bool bGradientNormals)
+	{
+		const std::string Case = GetCaseName(Density.Name, N, Method, bShareVertices, bGradientNormals);
+
+		Mesher Mesher(N);
+		Mesher.IsoLevel = Density.IsoLevel;
+		Mesher.Method = Method;
+		Mesher.bShareVertices = bShareVertices;
+		Mesher.bGradientNormals = bGradientNormals;
+		Mesher.BuildBrickSummary(Density.Values.data());
+		Mesher.MarchAll(Density.Values.data());
+
+		const int32_t NumVerts = Mesher.GetNumMergedVerts();
+		const int32_t NumIndices = Mesher.GetNumMergedIndices();
+		Check(NumIndices > 0, Case, "no triangles");
+		Check(NumIndices % 3 == 0, Case, "index count is not a multiple of 3");
+
+		std::vector<Vec3> Verts(NumVerts);
+		std::vector<Vec3> Normals(NumVerts);
+		std::vector<int32_t> Tris(NumIndices);
+		Check(Mesher.Merge(Verts.data(), Tris.data(), Normals.data()) == NumVerts, Case, "merged vertex count differs from GetNumMergedVerts");
+
+		// The weld table is kept between merges, a second merge must not see the vertices of the first
+		std::vector<Vec3> AgainVerts(NumVerts);
+		std::vector<int32_t> AgainTris(NumIndices);
+		Check(Mesher.Merge(AgainVerts.data(), AgainTris.data()) == NumVerts && AgainTris == Tris, Case, "merging again gives another mesh");
+
+		bool bIndicesInRange = true;
+		for (const int32_t Index : Tris)
+		{
+			bIndicesInRange &= Index >= 0 && Index < NumVerts;
+		}
+		Check(bIndicesInRange, Case, "index out of range");
+
+		const float Extent = static_cast<float>(N - 1);
+		bool bVertsInChunk = true;
+		for (const Vec3& Vert : Verts)
+		{
+			bVertsInChunk &= Vert.X >= 0.0f && Vert.X <= Extent && Vert.Y >= 0.0f && Vert.Y <= Extent && Vert.Z >= 0.0f && Vert.Z <= Extent;
+		}
+		Check(bVertsInChunk, Case, "vertex outside the chunk");
+
+		const bool bIndexed = bShareVertices || Method != MeshingMethod::MarchingCubes;
+		if (bIndexed)
+		{
+			const auto IsOnBorder = [Extent](const Vec3& Vert)
+			{
+				return Vert.X == 0.0f || Vert.X == Extent || Vert.Y == 0.0f || Vert.Y == Extent || Vert.Z == 0.0f || Vert.Z == Extent;
+			};
+			bool bClosedInside = true;
+			for (const auto& [From, To] : GetOpenEdges({ Verts, Tris }))
+			{
+				bClosedInside &= IsOnBorder(Verts[From]) && IsOnBorder(Verts[To]);
+			}
+			Check(bClosedInside, Case, "open edge inside the chunk");
+		}
+		return { std::move(Verts), std::move(Tris) };
+	}
+
+	using FacePoint = std::pair<long, long>;
+
+	// The open edges of a mesh on the chunk face at X = XPlane, in a canonical order. Marching cubes interpolates the
+	// vertices of a face from opposite ends in the two chunks, so (Y, Z) is snapped to a lattice far finer than a crack.
+	std::vector<std::pair<FacePoint, FacePoint>> GetFaceEdges(const TestMesh& Mesh, float XPlane)
+	{
+		const auto Snap = [](const Vec3& Vert)
+		{
+			return FacePoint(std::lround(Vert.Y * 1024.0f), std::lround(Vert.Z * 1024.0f));
+		};
+		std::vector<std::pair<FacePoint, FacePoint>> FaceEdges;
+		for (const auto& [From, To] : GetOpenEdges(Mesh))
+		{
+			const Vec3& A = Mesh.Verts[From];
+			const Vec3& B = Mesh.Verts[To];
+			if (A.X == XPlane && B.X == XPlane)
+			{
+				FaceEdges.push_back(std::minmax(Snap(A), Snap(B)));
+			}
+		}
+		std::sort(FaceEdges.begin(), FaceEdges.end());
+		return FaceEdges;
+	}
+
+	// Two chunks side by side in X must leave the same open edges on the face they share, or the terrain has a crack
+	void CheckNeighbours(int N, MeshingMethod Method, bool bGradientNormals)
+	{
+		const std::string Case = GetCaseName("Neighbours", N, Method, true, bGradientNormals);
+		const TestMesh Left = CheckMesh(MakeTerrain(N, 0), N, Method, true, bGradientNormals);
+		const TestMesh Right = CheckMesh(MakeTerrain(N, 1), N, Method, true, bGradientNormals);
+		const auto LeftEdges = GetFaceEdges(Left, static_cast<float>(N - 1));
+		const auto RightEdges = GetFaceEdges(Right, 0.0f);
+		Check(!LeftEdges.empty(), Case, "no surface on the shared face");
+		Check(LeftEdges == RightEdges, Case, "open edges on the shared face differ");
+	}
+}
+
+int main()
+{
+	// 33 points takes the static grid path, 20 the dynamic one with a partial last brick
+	for (const int N : { 33, 20 })
+	{
+		for (const TestDensity& Density : { MakeBall(N), MakeTerrain(N) })
+		{
+			for (const MeshingMethod Method : { MeshingMethod::MarchingCubes, MeshingMethod::SurfaceNets, MeshingMethod::DualContouring })
+			{
+				for (const bool bShareVertices : { false, true })
+				{
+					for (const bool bGradientNormals : { false, true })
+					{
+						CheckMesh(Density, N, Method, bShareVertices, bGradientNormals);
+					}
+				}
+			}
+		}
+		for (const MeshingMethod Method : { MeshingMethod::MarchingCubes, MeshingMethod::SurfaceNets, MeshingMethod::DualContouring })
+		{
+			CheckNeighbours(N, Method, false);
+			CheckNeighbours(N, Method, true);
+		}
+	}
+
+	if (NumFailures > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", NumFailures);
+		return 1;
+	}
+	std::printf("All mesher checks passed\n");
+	return 0;
+}
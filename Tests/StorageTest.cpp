@@ -0,0 +1,315 @@
+// Checks of the engine independent storage formats, built by the root CMakeLists.txt and run by ctest.
+//
+// Compact density grids are round tripped through every encoding and held to their error bounds, and the region file
+// and edit journal readers are fed truncated and torn input, which they have to reject or cut short instead of reading
+// past it.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Core/CompactDensity.h"
+#include "Core/EditJournal.h"
+#include "Core/RegionFile.h"
+#include "Core/TerrainDensity.h"
+
+using namespace MarchingCore;
+
+namespace
+{
+	int NumFailures = 0;
+
+	void Check(bool bCondition, const std::string& Case, const char* What)
+	{
+		if (!bCondition)
+		{
+			std::fprintf(stderr, "FAILED %s: %s\n", Case.c_str(), What);
+			NumFailures++;
+		}
+	}
+
+	constexpr int N = 33;
+	constexpr float IsoLevel = 0.5f;
+
+	std::vector<float> MakeTerrain()
+	{
+		std::vector<float> Density(static_cast<size_t>(N) * N * N);
+		const TerrainDensity Generator(TerrainSettings(), N);
+		Generator.FillChunk(Density.data(), 0, 0, 0);
+		return Density;
+	}
+
+	std::vector<float> Decode(const CompactDensity& Compact)
+	{
+		std::vector<float> Density(static_cast<size_t>(N) * N * N);
+		Compact.Decompress(Density.data());
+		return Density;
+	}
+
+	float GetRange(const std::vector<float>& Density)
+	{
+		float Range = 0.0f;
+		for (const float Value : Density)
+		{
+			Range = std::max(Range, std::abs(Value - IsoLevel));
+		}
+		return Range;
+	}
+
+	float GetMaxError(const std::vector<float>& A, const std::vector<float>& B)
+	{
+		float MaxError = 0.0f;
+		for (size_t i = 0; i < A.size(); i++)
+		{
+			MaxError = std::max(MaxError, std::abs(A[i] - B[i]));
+		}
+		return MaxError;
+	}
+
+	bool KeepsIsoSides(const std::vector<float>& A, const std::vector<float>& B)
+	{
+		for (size_t i = 0; i < A.size(); i++)
+		{
+			if ((A[i] < IsoLevel) != (B[i] < IsoLevel))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Serialize then Deserialize gives back the same grid, and no other size than the written one is accepted
+	void CheckSerialization(const CompactDensity& Compact, const std::string& Case)
+	{
+		std::vector<uint8_t> Bytes;
+		Compact.Serialize(Bytes);
+		Check(Bytes.size() == CompactDensity::GetSerializedSize(Compact.GetEncoding(), N), Case, "serialized size differs from GetSerializedSize");
+		Check(CompactDensity::IsSerializedSize(Bytes.size(), N), Case, "serialized size is not accepted");
+
+		CompactDensity Read;
+		Check(Read.Deserialize(Bytes.data(), Bytes.size()) && Read.GetEncoding() == Compact.GetEncoding(), Case, "deserialize failed");
+		Check(Decode(Read) == Decode(Compact), Case, "deserialized grid differs");
+
+		bool bRejectsTruncated = true;
+		for (size_t Size = 0; Size < Bytes.size(); Size += std::max<size_t>(1, Bytes.size() / 64))
+		{
+			bRejectsTruncated &= !Read.Deserialize(Bytes.data(), Size) && Read.IsEmpty();
+		}
+		Check(bRejectsTruncated, Case, "truncated grid accepted");
+
+		Bytes.push_back(0);
+		Check(!Read.Deserialize(Bytes.data(), Bytes.size()), Case, "grid with trailing bytes accepted");
+	}
+
+	void CheckCompactDensity()
+	{
+		const std::vector<float> Terrain = MakeTerrain();
+		const float Range = GetRange(Terrain);
+
+		CompactDensity Exact;
+		Exact.Compress(Terrain.data(), N, IsoLevel, DensityEncoding::Float);
+		Check(Exact.GetEncoding() == DensityEncoding::Float && Exact.IsExact(), "Float", "not stored as floats");
+		Check(Decode(Exact) == Terrain, "Float", "not lossless");
+		CheckSerialization(Exact, "Float");
+
+		// Up to half a step from rounding, a whole one for points below the iso level kept off it
+		CompactDensity Compact16;
+		Compact16.Compress(Terrain.data(), N, IsoLevel, DensityEncoding::Quantized16);
+		const std::vector<float> Decoded16 = Decode(Compact16);
+		Check(Compact16.GetEncoding() == DensityEncoding::Quantized16 && !Compact16.IsExact(), "Quantized16", "wrong encoding");
+		Check(GetMaxError(Terrain, Decoded16) <= Range / 32767.0f * 1.001f, "Quantized16", "error above one step");
+		Check(KeepsIsoSides(Terrain, Decoded16), "Quantized16", "point moved across the iso level");
+		CheckSerialization(Compact16, "Quantized16");
+
+		// The square root companding makes a step of the fraction F cost about 2 * F / 127 of the range
+		CompactDensity Compact8;
+		Compact8.Compress(Terrain.data(), N, IsoLevel, DensityEncoding::Quantized8);
+		const std::vector<float> Decoded8 = Decode(Compact8);
+		const float Step8 = 1.0f / 127.0f;
+		Check(Compact8.GetEncoding() == DensityEncoding::Quantized8 && !Compact8.IsExact(), "Quantized8", "wrong encoding");
+		Check(GetMaxError(Terrain, Decoded8) <= (2.0f * Step8 + Step8 * Step8) * Range * 1.001f, "Quantized8", "error above one step");
+		Check(KeepsIsoSides(Terrain, Decoded8), "Quantized8", "point moved across the iso level");
+		bool bFinerNearSurface = true;
+		for (size_t i = 0; i < Terrain.size(); i++)
+		{
+			// Within 1% of the range from the surface the step is a fifth of the step at the far end
+			if (std::abs(Terrain[i] - IsoLevel) < 0.01f * Range)
+			{
+				bFinerNearSurface &= std::abs(Terrain[i] - Decoded8[i]) <= 0.4f * Step8 * Range;
+			}
+		}
+		Check(bFinerNearSurface, "Quantized8", "points near the surface lost their precision");
+		CheckSerialization(Compact8, "Quantized8");
+
+		// Compressing a decoded grid again gives the same grid, a chunk compressed and expanded over and over doesn't drift
+		for (const DensityEncoding Encoding : { DensityEncoding::Quantized16, DensityEncoding::Quantized8 })
+		{
+			const std::string Case = Encoding == DensityEncoding::Quantized16 ? "Quantized16/Stable" : "Quantized8/Stable";
+			CompactDensity First;
+			First.Compress(Terrain.data(), N, IsoLevel, Encoding);
+			const std::vector<float> Once = Decode(First);
+			CompactDensity Second;
+			Second.Compress(Once.data(), N, IsoLevel, Encoding);
+			const std::vector<float> Twice = Decode(Second);
+			Check(GetMaxError(Once, Twice) == 0.0f, Case, "decode and encode again changed the grid");
+		}
+
+		// Layered grids, including one at the iso level everywhere where the quantizers would have no range, stay exact
+		std::vector<float> Layered(Terrain.size());
+		for (int z = 0; z < N; z++)
+		{
+			std::fill_n(Layered.begin() + static_cast<size_t>(z) * N * N, N * N, IsoLevel + 0.25f * (N / 2 - z));
+		}
+		const std::vector<float> Flat(Terrain.size(), IsoLevel);
+		for (const DensityEncoding Encoding : { DensityEncoding::Float, DensityEncoding::Quantized16, DensityEncoding::Quantized8 })
+		{
+			CompactDensity Compact;
+			Compact.Compress(Layered.data(), N, IsoLevel, Encoding);
+			Check(Compact.GetEncoding() == DensityEncoding::Layers && Compact.IsExact(), "Layers", "layered grid not stored as layers");
+			Check(Decode(Compact) == Layered, "Layers", "layers not lossless");
+			CheckSerialization(Compact, "Layers");
+
+			Compact.Compress(Flat.data(), N, IsoLevel, Encoding);
+			Check(Compact.GetEncoding() == DensityEncoding::Layers, "ZeroRange", "grid at the iso level not stored as layers");
+			Check(Decode(Compact) == Flat, "ZeroRange", "grid at the iso level changed");
+		}
+	}
+
+	// A region file with the chunk at entry 0 saved in a blob of BlobSize bytes
+	std::vector<uint8_t> MakeRegionFile(uint32_t BlobSize)
+	{
+		std::vector<uint8_t> File(RegionFile::DataOffset + RegionFile::AlignCapacity(BlobSize));
+		RegionFile::Header FileHeader;
+		FileHeader.PointsPerChunk = N;
+		std::memcpy(File.data(), &FileHeader, sizeof(FileHeader));
+
+		RegionFile::Entry Entry;
+		Entry.Offset = RegionFile::DataOffset;
+		Entry.Capacity = RegionFile::AlignCapacity(BlobSize);
+		Entry.Size = BlobSize;
+		Entry.Sequence = 7;
+		std::memcpy(File.data() + RegionFile::GetEntryOffset(0), &Entry, sizeof(Entry));
+
+		const uint32_t UncompressedSize = static_cast<uint32_t>(CompactDensity::GetSerializedSize(DensityEncoding::Float, N));
+		std::memcpy(File.data() + Entry.Offset, &UncompressedSize, sizeof(UncompressedSize));
+		return File;
+	}
+
+	void SetEntry(std::vector<uint8_t>& File, const RegionFile::Entry& Entry)
+	{
+		std::memcpy(File.data() + RegionFile::GetEntryOffset(0), &Entry, sizeof(Entry));
+	}
+
+	void CheckRegionFile()
+	{
+		const uint32_t BlobSize = 100;
+		std::vector<uint8_t> File = MakeRegionFile(BlobSize);
+		RegionFile::Entry Entry;
+		Check(RegionFile::IsCompatible(File.data(), File.size(), N), "RegionFile", "valid file rejected");
+		Check(RegionFile::ReadEntry(File.data(), File.size(), 0, Entry) && Entry.Size == BlobSize && Entry.Sequence == 7, "RegionFile", "valid entry rejected");
+		Check(!RegionFile::ReadEntry(File.data(), File.size(), 1, Entry), "RegionFile", "unsaved entry read");
+
+		uint32_t UncompressedSize = 0;
+		Check(RegionFile::ReadUncompressedSize(File.data() + RegionFile::DataOffset, BlobSize, N, UncompressedSize)
+			&& UncompressedSize == CompactDensity::GetSerializedSize(DensityEncoding::Float, N), "RegionFile", "valid blob size rejected");
+		Check(!RegionFile::ReadUncompressedSize(File.data() + RegionFile::DataOffset, sizeof(uint32_t) - 1, N, UncompressedSize), "RegionFile", "blob shorter than its size read");
+		Check(!RegionFile::ReadUncompressedSize(File.data() + RegionFile::DataOffset, BlobSize, N + 1, UncompressedSize), "RegionFile", "blob size of another resolution accepted");
+		const uint32_t Bogus = 0x7FFFFFFF;
+		std::vector<uint8_t> BogusBlob(sizeof(Bogus));
+		std::memcpy(BogusBlob.data(), &Bogus, sizeof(Bogus));
+		Check(!RegionFile::ReadUncompressedSize(BogusBlob.data(), BogusBlob.size(), N, UncompressedSize), "RegionFile", "impossible blob size accepted");
+
+		// Cut anywhere inside the table the file is no region, cut inside the blob its entry points past the end
+		Check(!RegionFile::IsCompatible(File.data(), RegionFile::DataOffset - 1, N), "RegionFile", "file with a partial table accepted");
+		Check(!RegionFile::IsCompatible(File.data(), File.size(), N + 1), "RegionFile", "file of another resolution accepted");
+		Check(!RegionFile::ReadEntry(File.data(), RegionFile::DataOffset + BlobSize - 1, 0, Entry), "RegionFile", "entry past the end of a truncated file read");
+
+		std::vector<uint8_t> OtherVersion = File;
+		RegionFile::Header FileHeader;
+		std::memcpy(&FileHeader, OtherVersion.data(), sizeof(FileHeader));
+		FileHeader.Version++;
+		std::memcpy(OtherVersion.data(), &FileHeader, sizeof(FileHeader));
+		Check(!RegionFile::IsCompatible(OtherVersion.data(), OtherVersion.size(), N), "RegionFile", "file of another version accepted");
+
+		// Torn entries: a blob larger than its slot, or a slot inside the table
+		RegionFile::Entry Torn;
+		Torn.Offset = RegionFile::DataOffset;
+		Torn.Capacity = RegionFile::BlobAlignment;
+		Torn.Size = RegionFile::BlobAlignment + 1;
+		SetEntry(File, Torn);
+		Check(!RegionFile::ReadEntry(File.data(), File.size(), 0, Entry), "RegionFile", "blob larger than its slot read");
+		Torn.Offset = RegionFile::TableOffset;
+		Torn.Size = BlobSize;
+		SetEntry(File, Torn);
+		Check(!RegionFile::ReadEntry(File.data(), File.size(), 0, Entry), "RegionFile", "blob inside the table read");
+		Torn.Offset = RegionFile::DataOffset;
+		Torn.Size = sizeof(uint32_t) - 1;
+		SetEntry(File, Torn);
+		Check(!RegionFile::ReadEntry(File.data(), File.size(), 0, Entry), "RegionFile", "blob without its size read");
+	}
+
+	void CheckEditJournal()
+	{
+		EditJournal::Header JournalHeader;
+		JournalHeader.NextSequence = 4;
+		std::vector<uint8_t> Bytes;
+		EditJournal::AppendHeader(Bytes, JournalHeader);
+		for (uint32_t Sequence = 1; Sequence <= 3; Sequence++)
+		{
+			BrushEdit Edit;
+			Edit.Sequence = Sequence;
+			Edit.CenterX = 10.0f * Sequence;
+			Edit.Radius = 4.0f;
+			Edit.Strength = -1.0f;
+			EditJournal::AppendRecord(Bytes, Edit);
+		}
+
+		EditJournal::Header ReadHeader;
+		std::vector<BrushEdit> Edits;
+		Check(EditJournal::Read(Bytes.data(), Bytes.size(), ReadHeader, Edits) && ReadHeader.NextSequence == 4, "EditJournal", "valid journal rejected");
+		Check(Edits.size() == 3 && Edits[2].Sequence == 3 && Edits[2].CenterX == 30.0f, "EditJournal", "records lost");
+
+		// A crash while appending leaves the whole records before it
+		bool bTruncatedReadsWholeRecords = true;
+		for (size_t Size = 0; Size < Bytes.size(); Size++)
+		{
+			const bool bRead = EditJournal::Read(Bytes.data(), Size, ReadHeader, Edits);
+			if (Size < sizeof(EditJournal::Header))
+			{
+				bTruncatedReadsWholeRecords &= !bRead;
+			}
+			else
+			{
+				bTruncatedReadsWholeRecords &= bRead && Edits.size() == (Size - sizeof(EditJournal::Header)) / EditJournal::RecordSize;
+			}
+		}
+		Check(bTruncatedReadsWholeRecords, "EditJournal", "truncated journal not cut at the last whole record");
+
+		// A damaged record ends the journal, the records after it are not trusted either
+		std::vector<uint8_t> Torn = Bytes;
+		Torn[sizeof(EditJournal::Header) + EditJournal::RecordSize + 5] ^= 0x40;
+		Check(EditJournal::Read(Torn.data(), Torn.size(), ReadHeader, Edits) && Edits.size() == 1, "EditJournal", "damaged record read");
+
+		std::vector<uint8_t> NoJournal = Bytes;
+		NoJournal[0] ^= 0xFF;
+		Check(!EditJournal::Read(NoJournal.data(), NoJournal.size(), ReadHeader, Edits), "EditJournal", "file with another magic read");
+	}
+}
+
+int main()
+{
+	CheckCompactDensity();
+	CheckRegionFile();
+	CheckEditJournal();
+
+	if (NumFailures > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", NumFailures);
+		return 1;
+	}
+	std::printf("All storage checks passed\n");
+	return 0;
+}